@@ -0,0 +1,14 @@
+#pragma once
+
+/* 发生器配置 */
+typedef struct GeneratorConfig {
+    int         threads        = 1;       /* Worker线程数量，会话平均分给各线程 */
+    double      rate           = 0;       /* 开环模式下每个客户端每秒发送的报文数，0表示闭环（能发就发） */
+    double      connRate       = 0;       /* 所有Worker合计每秒发起的连接数，0表示不限速 */
+    int         connBurst      = 64;      /* 每个Worker每轮事件循环最多发起的连接数 */
+    int         connPending    = 0;       /* 每个Worker同时进行中的连接数上限，0表示按connBurst推算 */
+    double      burstOn        = 0;       /* 突发模式下开阶段的平均时长（毫秒），0表示一直发送 */
+    double      burstOff       = 0;       /* 突发模式下关阶段的平均时长（毫秒） */
+    const char* seriesFile     = nullptr; /* 时间序列输出文件，nullptr表示不输出 */
+    double      seriesInterval = 1;       /* 时间序列的采样间隔（秒） */
+} GeneratorConfig;
@@ -0,0 +1,150 @@
+#include "LatencyHistogram.hpp"
+#include <algorithm>
+#include <cmath>
+
+#define HDR_FILE_MAGIC "HDR1" /* save保存的文件的第一个字段 */
+
+/* 值v所在的2的幂区间为bucket，区间内的线性子桶为sub：
+ * bucket 0覆盖[0, 2^HDR_SUB_BUCKET_BITS)，之后每个区间覆盖[2^(b+10), 2^(b+11))，各分成HDR_SUB_BUCKET_HALF个子桶 */
+size_t LatencyHistogram::indexOf(uint64_t value) {
+    int      bucket = 64 - __builtin_clzll(value | ((1ULL << HDR_SUB_BUCKET_BITS) - 1)) - HDR_SUB_BUCKET_BITS;
+    uint64_t sub    = value >> bucket;
+    return ((size_t)(bucket + 1) << (HDR_SUB_BUCKET_BITS - 1)) + (sub - HDR_SUB_BUCKET_HALF);
+}
+
+uint64_t LatencyHistogram::lowestAt(size_t index) {
+    int      bucket = (int)(index >> (HDR_SUB_BUCKET_BITS - 1)) - 1;
+    uint64_t sub    = (index & (HDR_SUB_BUCKET_HALF - 1)) + HDR_SUB_BUCKET_HALF;
+    if (bucket < 0) {
+        sub -= HDR_SUB_BUCKET_HALF;
+        bucket = 0;
+    }
+    return sub << bucket;
+}
+
+uint64_t LatencyHistogram::highestAt(size_t index) {
+    int bucket = std::max((int)(index >> (HDR_SUB_BUCKET_BITS - 1)) - 1, 0);
+    return lowestAt(index) + (1ULL << bucket) - 1;
+}
+
+void LatencyHistogram::record(uint64_t value) {
+    if (value > HDR_MAX_VALUE) {
+        value = HDR_MAX_VALUE;
+        clamped++;
+    }
+    counts[indexOf(value)]++;
+    minValue = (total == 0 || value < minValue) ? value : minValue;
+    maxValue = std::max(maxValue, value);
+    sum += value;
+    total++;
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+    if (other.total == 0) {
+        return;
+    }
+    for (size_t i = 0; i < HDR_COUNTS_LEN; ++i) {
+        counts[i] += other.counts[i];
+    }
+    minValue = total == 0 ? other.minValue : std::min(minValue, other.minValue);
+    maxValue = std::max(maxValue, other.maxValue);
+    sum += other.sum;
+    total += other.total;
+    clamped += other.clamped;
+}
+
+void LatencyHistogram::reset() {
+    std::fill(counts.begin(), counts.end(), 0);
+    total = minValue = maxValue = sum = clamped = 0;
+}
+
+uint64_t LatencyHistogram::percentile(double percentile) const {
+    if (total == 0) {
+        return 0;
+    }
+    percentile      = std::min(std::max(percentile, 0.0), 100.0);
+    uint64_t target = std::max((uint64_t)std::ceil(percentile / 100 * total), (uint64_t)1);
+    uint64_t seen   = 0;
+    for (size_t i = 0; i < HDR_COUNTS_LEN; ++i) {
+        seen += counts[i];
+        if (seen >= target) {
+            return std::min(highestAt(i), maxValue);
+        }
+    }
+    return maxValue;
+}
+
+void LatencyHistogram::dump(FILE* fp) const {
+    fprintf(fp, "%12s %14s %10s %14s\n\n", "Value", "Percentile", "TotalCount", "1/(1-Percentile)");
+    uint64_t seen = 0;
+    for (size_t i = 0; i < HDR_COUNTS_LEN; ++i) {
+        if (counts[i] == 0) {
+            continue;
+        }
+        seen += counts[i];
+        double fraction = (double)seen / total;
+        double value    = (double)std::min(highestAt(i), maxValue) / 1000000;
+        if (seen < total) {
+            fprintf(fp, "%12.3f %2.12f %10lu %14.2f\n", value, fraction, seen, 1 / (1 - fraction));
+        }
+        else {
+            fprintf(fp, "%12.3f %2.12f %10lu\n", value, fraction, seen);
+        }
+    }
+    /* 标准差按每个桶的中点估计 */
+    double variance = 0;
+    for (size_t i = 0; i < HDR_COUNTS_LEN && total > 0; ++i) {
+        if (counts[i] > 0) {
+            double dev = ((double)lowestAt(i) + highestAt(i)) / 2 - mean();
+            variance += dev * dev * counts[i] / total;
+        }
+    }
+    fprintf(fp, "#[Mean    = %12.3f, StdDeviation   = %12.3f]\n", mean() / 1000000, std::sqrt(variance) / 1000000);
+    fprintf(fp, "#[Max     = %12.3f, Total count    = %12lu]\n", (double)maxValue / 1000000, total);
+    fprintf(fp, "#[Buckets = %12d, SubBuckets     = %12d]\n", HDR_MAX_VALUE_BITS - HDR_SUB_BUCKET_BITS + 1,
+            1 << HDR_SUB_BUCKET_BITS);
+}
+
+int LatencyHistogram::save(const char* path) const {
+    FILE* fp = fopen(path, "w");
+    if (fp == nullptr) {
+        return -1;
+    }
+    fprintf(fp, "%s %d %d %lu %lu %lu %lu %lu\n", HDR_FILE_MAGIC, HDR_SUB_BUCKET_BITS, HDR_MAX_VALUE_BITS, total,
+            min(), maxValue, sum, clamped);
+    for (size_t i = 0; i < HDR_COUNTS_LEN; ++i) {
+        if (counts[i] > 0) {
+            fprintf(fp, "%zu %lu\n", i, counts[i]);
+        }
+    }
+    return fclose(fp);
+}
+
+int LatencyHistogram::load(const char* path) {
+    FILE* fp = fopen(path, "r");
+    if (fp == nullptr) {
+        return -1;
+    }
+    char             magic[8];
+    int              subBits, maxBits;
+    LatencyHistogram other;
+    if (fscanf(fp, "%7s %d %d %lu %lu %lu %lu %lu", magic, &subBits, &maxBits, &other.total, &other.minValue,
+               &other.maxValue, &other.sum, &other.clamped)
+            != 8
+        || strcmp(magic, HDR_FILE_MAGIC) != 0 || subBits != HDR_SUB_BUCKET_BITS || maxBits != HDR_MAX_VALUE_BITS) {
+        fclose(fp);
+        return -1;
+    }
+    size_t   index;
+    uint64_t n;
+    while (fscanf(fp, "%zu %lu", &index, &n) == 2) {
+        if (index >= HDR_COUNTS_LEN) {
+            fclose(fp);
+            return -1;
+        }
+        other.counts[index] += n;
+    }
+    fclose(fp);
+    merge(other);
+    return 0;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "../common/common.hpp"
+#include <vector>
+
+#define HDR_SUB_BUCKET_BITS 11 /* 每个2的幂区间分成2^10个线性子桶，相对误差不超过1/1024（3位有效数字） */
+#define HDR_MAX_VALUE_BITS 42  /* 可记录的最大值为2^42 - 1纳秒（约73分钟），更大的值按最大值记录 */
+#define HDR_SUB_BUCKET_HALF (1 << (HDR_SUB_BUCKET_BITS - 1))
+#define HDR_COUNTS_LEN ((HDR_MAX_VALUE_BITS - HDR_SUB_BUCKET_BITS + 2) * HDR_SUB_BUCKET_HALF)
+#define HDR_MAX_VALUE ((1ULL << HDR_MAX_VALUE_BITS) - 1)
+
+/* HDR风格的延迟直方图（单位：纳秒）：桶按2的幂分段，每段内线性划分，
+ * 内存固定为HDR_COUNTS_LEN个计数，记录一次只需几条指令。
+ * 桶的划分与实例无关，因此不同线程、不同次运行的直方图可以直接逐桶相加 */
+class LatencyHistogram {
+private:
+    std::vector<uint64_t> counts;       /* 每个桶的计数 */
+    uint64_t              total    = 0; /* 记录的值的个数 */
+    uint64_t              minValue = 0; /* 最小值（total为0时无意义） */
+    uint64_t              maxValue = 0; /* 最大值 */
+    uint64_t              sum      = 0; /* 所有值的和 */
+    uint64_t              clamped  = 0; /* 超过HDR_MAX_VALUE而按最大值记录的个数 */
+
+    static size_t   indexOf(uint64_t value);
+    static uint64_t lowestAt(size_t index);
+    static uint64_t highestAt(size_t index);
+
+public:
+    LatencyHistogram() : counts(HDR_COUNTS_LEN, 0) {}
+
+    /* 记录一个值 */
+    void record(uint64_t value);
+
+    /* 把other的所有计数累加到本直方图 */
+    void merge(const LatencyHistogram& other);
+
+    /* 清空所有计数 */
+    void reset();
+
+    /* 返回不小于percentile%的值所在桶的上界，percentile取值为[0, 100] */
+    uint64_t percentile(double percentile) const;
+
+    uint64_t count() const {
+        return total;
+    }
+
+    uint64_t min() const {
+        return total > 0 ? minValue : 0;
+    }
+
+    uint64_t max() const {
+        return maxValue;
+    }
+
+    double mean() const {
+        return total > 0 ? (double)sum / total : 0;
+    }
+
+    uint64_t clampedCount() const {
+        return clamped;
+    }
+
+    /* 以HdrHistogram的百分位分布格式（.hgrm）输出完整分布，值的单位为毫秒 */
+    void dump(FILE* fp) const;
+
+    /* 保存为可合并的文本格式：一行汇总信息，随后每个非空桶一行“下标 计数” */
+    int save(const char* path) const;
+
+    /* 读取save保存的直方图并累加到本直方图 */
+    int load(const char* path);
+};
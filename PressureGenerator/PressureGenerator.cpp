@@ -1,22 +1,38 @@
 #include "PressureGenerator.hpp"
-#include <vector>
-
-#define CONN_SIZE 2
-#define ERROR_MAX 10
-#define WAIT_CONN_MAX 200
+#include <algorithm>
 
 int PressureGenerator::alrmFlag = 0;
 int PressureGenerator::intFlag  = 0;
 int PressureGenerator::exitFlag = 0;
 
-int PressureGenerator::start(const char* ip, const char* port, int sessCount, int runTime, int packetSize,
+int PressureGenerator::start(const char* ip, const char* port, int sessCount, int runTime, const char* packetSize,
                              int logFlag) {
     if (sessCount <= 0) {
         printf("The number of sessions must be positive\n");
         return -1;
     }
-    if (sessCount * 2 > MAX_EVENT_NUMBER) {
-        printf("The number of sessions must be less than %d\n", MAX_EVENT_NUMBER / 2);
+    if (config.threads <= 0) {
+        printf("The number of threads must be positive\n");
+        return -1;
+    }
+    if (sessCount * 2 > MAX_EVENT_NUMBER * config.threads) {
+        printf("The number of sessions must be less than %d per thread\n", MAX_EVENT_NUMBER / 2);
+        return -1;
+    }
+    if (config.connRate < 0 || config.connBurst <= 0 || config.connPending < 0) {
+        printf("The connect rate and pending connects must not be negative and the connect burst must be positive\n");
+        return -1;
+    }
+    if (config.rate < 0 || (config.rate > 0 && NANO_SEC / config.rate < 1)) {
+        printf("The packet rate must be between 0 and %d\n", NANO_SEC);
+        return -1;
+    }
+    if (config.burstOn < 0 || config.burstOff < 0 || (config.burstOn == 0 && config.burstOff > 0)) {
+        printf("The burst on and off periods must not be negative, and the on period must be positive\n");
+        return -1;
+    }
+    if (config.seriesInterval <= 0) {
+        printf("The sample interval must be positive\n");
         return -1;
     }
     this->cliCount = (size_t)sessCount * 2;
@@ -24,10 +40,15 @@ int PressureGenerator::start(const char* ip, const char* port, int sessCount, in
         printf("The test time must be positive\n");
     }
     this->runTime = runTime;
-    if (packetSize <= (int)sizeof(Header)) {
-        printf("The packet size must be larger than header size (%zd)\n", sizeof(Header));
+    if (sizes.parse(packetSize) < 0) {
+        printf("Invalid packet size distribution %s\n", packetSize);
+        return -1;
+    }
+    if (sizes.min() < sizeof(PacketPrefix) || sizes.max() - sizeof(Header) > UINT16_MAX) {
+        printf("The packet size must be between %zd and %zd\n", sizeof(PacketPrefix), sizeof(Header) + UINT16_MAX);
+        return -1;
     }
-    this->payloadSize = packetSize - sizeof(Header);
+    this->payloadSize = sizes.max() - sizeof(Header);
     if (status != 0) {
         printf("This PressureGenerator has been started.\n");
         return -1;
@@ -45,9 +66,23 @@ int PressureGenerator::start(const char* ip, const char* port, int sessCount, in
         logfp = nullptr;
         printf("No log file specified.\n");
     }
+    if (config.seriesFile != nullptr) {
+        if (series.open(config.seriesFile) < 0) {
+            printf("Failed to open time series file %s.\n", config.seriesFile);
+            return -1;
+        }
+        printf("The time series is written to %s every %lf seconds.\n", config.seriesFile, config.seriesInterval);
+    }
     /* 开始生成报文，并启动测试 */
     generatePacket();
     logInfo(0, logfp, "PressureGenerator - generator - plan to run %d seconds", this->runTime);
+    if (config.rate > 0) {
+        logInfo(0, logfp, "PressureGenerator - generator - open loop, %lf packets per second per client", config.rate);
+    }
+    if (config.burstOn > 0) {
+        logInfo(0, logfp, "PressureGenerator - generator - bursts, on %lf ms and off %lf ms on average", config.burstOn,
+                config.burstOff);
+    }
     alarm(this->runTime);
     int r = doit(ip, port);
     logInfo(0, logfp, "PressureGenerator - generator - generator shutdowns");
@@ -59,14 +94,20 @@ int PressureGenerator::start(const char* ip, const char* port, int sessCount, in
     else {
         // g_averageDelay =
         //     (double)g_totalDelay.tv_sec / g_recvPackets + (double)g_totalDelay.tv_nsec / g_recvPackets / NANO_SEC;
-        g_averageDelay                        = g_totalDelay / g_recvPackets;
+        g_averageDelay                        = total.totalDelay / total.recvPackets;
+        g_connectTime                         = std::chrono::duration<double>(startTime - rampStart).count();
         std::chrono::duration<double> elapsed = endTime - startTime;
         g_testTime                            = elapsed.count();
-        g_recvSpeed                           = (uint64_t)((double)g_recvBytes / g_testTime);
-        g_sendSpeed                           = (uint64_t)((double)g_sendBytes / g_testTime);
+        g_recvSpeed                           = (uint64_t)((double)total.recvBytes / g_testTime);
+        g_sendSpeed                           = (uint64_t)((double)total.sendBytes / g_testTime);
         printStatistics();
+        if (logFlag) {
+            saveLatency();
+        }
     }
+    series.close();
     if (logfp != nullptr) {
+        logFlush(logfp);
         fclose(logfp);
         logfp = nullptr;
     }
@@ -77,340 +118,241 @@ int PressureGenerator::start(const char* ip, const char* port, int sessCount, in
 void PressureGenerator::printStatistics() {
     logInfo(0, logfp, "PressureGenerator - generator - Statistics:");
     logInfo(0, logfp, "PressureGenerator - generator - usrBufferSize: %d", BUFFER_SIZE);
-    logInfo(0, logfp, "PressureGenerator - generator - packetSize: %zd", payloadSize + sizeof(Header));
+    logInfo(0, logfp, "PressureGenerator - generator - packetSize: %s", sizes.describe());
+    logInfo(0, logfp, "PressureGenerator - generator - averagePacketSize: %lf", averagePacketSize());
     logInfo(0, logfp, "PressureGenerator - generator - testTime: %lf", g_testTime);
     logInfo(0, logfp, "PressureGenerator - generator - averageDelay: %lf", g_averageDelay);
-    logInfo(0, logfp, "PressureGenerator - generator - recvBytes: %lu", g_recvBytes);
+    logInfo(0, logfp, "PressureGenerator - generator - p50Delay: %lf", (double)latency.percentile(50) / 1000000);
+    logInfo(0, logfp, "PressureGenerator - generator - p90Delay: %lf", (double)latency.percentile(90) / 1000000);
+    logInfo(0, logfp, "PressureGenerator - generator - p99Delay: %lf", (double)latency.percentile(99) / 1000000);
+    logInfo(0, logfp, "PressureGenerator - generator - p999Delay: %lf", (double)latency.percentile(99.9) / 1000000);
+    logInfo(0, logfp, "PressureGenerator - generator - maxDelay: %lf", (double)latency.max() / 1000000);
+    logInfo(0, logfp, "PressureGenerator - generator - connectTime: %lf", g_connectTime);
+    logInfo(0, logfp, "PressureGenerator - generator - connectSpeed: %lf", cliCount / g_connectTime);
+    logInfo(0, logfp, "PressureGenerator - generator - connectErrors: %lu", total.connectErrors);
+    logInfo(0, logfp, "PressureGenerator - generator - connectPending: %zd", shared.connPending);
+    logInfo(0, logfp, "PressureGenerator - generator - connectCapped: %lu", total.connectCapped);
+    logInfo(0, logfp, "PressureGenerator - generator - p50Connect: %lf",
+            (double)connectLatency.percentile(50) / 1000000);
+    logInfo(0, logfp, "PressureGenerator - generator - p99Connect: %lf",
+            (double)connectLatency.percentile(99) / 1000000);
+    logInfo(0, logfp, "PressureGenerator - generator - maxConnect: %lf", (double)connectLatency.max() / 1000000);
+    logInfo(0, logfp, "PressureGenerator - generator - recvBytes: %lu", total.recvBytes);
     logInfo(0, logfp, "PressureGenerator - generator - recvSpeed: %lu", g_recvSpeed);
-    logInfo(0, logfp, "PressureGenerator - generator - recvPackets: %lu", g_recvPackets);
-    logInfo(0, logfp, "PressureGenerator - generator - recvFINs: %lu", g_recvFINs);
-    logInfo(0, logfp, "PressureGenerator - generator - recvSuccess: %lu", g_recvSuccess);
-    logInfo(0, logfp, "PressureGenerator - generator - recvEAGAIN: %lu", g_recvEAGAIN);
-    logInfo(0, logfp, "PressureGenerator - generator - recvError: %lu", g_recvError);
-    logInfo(0, logfp, "PressureGenerator - generator - sendBytes: %lu", g_sendBytes);
+    logInfo(0, logfp, "PressureGenerator - generator - recvPackets: %lu", total.recvPackets);
+    logInfo(0, logfp, "PressureGenerator - generator - recvFINs: %lu", total.recvFINs);
+    logInfo(0, logfp, "PressureGenerator - generator - recvSuccess: %lu", total.recvSuccess);
+    logInfo(0, logfp, "PressureGenerator - generator - recvEAGAIN: %lu", total.recvEAGAIN);
+    logInfo(0, logfp, "PressureGenerator - generator - recvError: %lu", total.recvError);
+    logInfo(0, logfp, "PressureGenerator - generator - recvLost: %lu", total.recvLost);
+    logInfo(0, logfp, "PressureGenerator - generator - recvReordered: %lu", total.recvReordered);
+    logInfo(0, logfp, "PressureGenerator - generator - recvCorrupted: %lu", total.recvCorrupted);
+    logInfo(0, logfp, "PressureGenerator - generator - sendBytes: %lu", total.sendBytes);
     logInfo(0, logfp, "PressureGenerator - generator - sendSpeed: %lu", g_sendSpeed);
-    logInfo(0, logfp, "PressureGenerator - generator - sendPackets: %lu", g_sendPackets);
-    logInfo(0, logfp, "PressureGenerator - generator - sendSuccess: %lu", g_sendSuccess);
-    logInfo(0, logfp, "PressureGenerator - generator - sendEAGAIN: %lu", g_sendEAGAIN);
-    logInfo(0, logfp, "PressureGenerator - generator - sendError: %lu", g_sendError);
+    logInfo(0, logfp, "PressureGenerator - generator - sendPackets: %lu", total.sendPackets);
+    logInfo(0, logfp, "PressureGenerator - generator - sendSuccess: %lu", total.sendSuccess);
+    logInfo(0, logfp, "PressureGenerator - generator - sendEAGAIN: %lu", total.sendEAGAIN);
+    logInfo(0, logfp, "PressureGenerator - generator - sendError: %lu", total.sendError);
+    logInfo(0, logfp, "PressureGenerator - generator - sendLate: %lu", total.sendLate);
     printf("PressureGenerator statistics:\n\n");
     printf("usrBufferSize: %d\n", BUFFER_SIZE);
-    printf("packetSize: %zd\n", payloadSize + sizeof(Header));
+    printf("packetSize: %s\n", sizes.describe());
+    printf("averagePacketSize: %lf\n", averagePacketSize());
     printf("testTime: %lf\n", g_testTime);
-    printf("averageDelay: %lf\n\n", g_averageDelay);
-    printf("recvBytes: %lu\n", g_recvBytes);
+    printf("averageDelay: %lf\n", g_averageDelay);
+    printf("p50Delay: %lf\n", (double)latency.percentile(50) / 1000000);
+    printf("p90Delay: %lf\n", (double)latency.percentile(90) / 1000000);
+    printf("p99Delay: %lf\n", (double)latency.percentile(99) / 1000000);
+    printf("p999Delay: %lf\n", (double)latency.percentile(99.9) / 1000000);
+    printf("maxDelay: %lf\n\n", (double)latency.max() / 1000000);
+    printf("connectTime: %lf\n", g_connectTime);
+    printf("connectSpeed: %lf\n", cliCount / g_connectTime);
+    printf("connectErrors: %lu\n", total.connectErrors);
+    printf("connectPending: %zd\n", shared.connPending);
+    printf("connectCapped: %lu\n", total.connectCapped);
+    printf("p50Connect: %lf\n", (double)connectLatency.percentile(50) / 1000000);
+    printf("p99Connect: %lf\n", (double)connectLatency.percentile(99) / 1000000);
+    printf("maxConnect: %lf\n\n", (double)connectLatency.max() / 1000000);
+    printf("recvBytes: %lu\n", total.recvBytes);
     printf("recvSpeed: %lu\n", g_recvSpeed);
-    printf("recvPackets: %lu\n", g_recvPackets);
-    printf("recvFINs: %lu\n", g_recvFINs);
-    printf("recvSuccess: %lu\n", g_recvSuccess);
-    printf("recvEAGAIN: %lu\n", g_recvEAGAIN);
-    printf("recvError: %lu\n\n", g_recvError);
-    printf("sendBytes: %lu\n", g_sendBytes);
+    printf("recvPackets: %lu\n", total.recvPackets);
+    printf("recvFINs: %lu\n", total.recvFINs);
+    printf("recvSuccess: %lu\n", total.recvSuccess);
+    printf("recvEAGAIN: %lu\n", total.recvEAGAIN);
+    printf("recvError: %lu\n", total.recvError);
+    printf("recvLost: %lu\n", total.recvLost);
+    printf("recvReordered: %lu\n", total.recvReordered);
+    printf("recvCorrupted: %lu\n\n", total.recvCorrupted);
+    printf("sendBytes: %lu\n", total.sendBytes);
     printf("sendSpeed: %lu\n", g_sendSpeed);
-    printf("sendPackets: %lu\n", g_sendPackets);
-    printf("sendSuccess: %lu\n", g_sendSuccess);
-    printf("sendEAGAIN: %lu\n", g_sendEAGAIN);
-    printf("sendError: %lu\n", g_sendError);
+    printf("sendPackets: %lu\n", total.sendPackets);
+    printf("sendSuccess: %lu\n", total.sendSuccess);
+    printf("sendEAGAIN: %lu\n", total.sendEAGAIN);
+    printf("sendError: %lu\n", total.sendError);
+    printf("sendLate: %lu\n", total.sendLate);
+}
+
+/* 保存可合并的延迟直方图，并输出完整的百分位分布 */
+int PressureGenerator::saveLatency() {
+    if (latency.save(hdrFilename) < 0) {
+        return logError(-1, logfp, "PressureGenerator - generator - failed to save %s", hdrFilename);
+    }
+    FILE* fp = fopen(pctFilename, "w");
+    if (fp == nullptr) {
+        return logError(-1, logfp, "PressureGenerator - generator - failed to open %s", pctFilename);
+    }
+    latency.dump(fp);
+    fclose(fp);
+    printf("The latency histogram is saved as %s and %s.\n", hdrFilename, pctFilename);
+    return 0;
 }
 
 void PressureGenerator::generatePacket() {
     assert(payload == nullptr);
-    payload = new char[payloadSize];
-    memset(payload, 'M', payloadSize);
+    /* PacketTag之后的内容从payload的第(序号 % PATTERN_PERIOD)个字节开始取，用伪随机字节填充使错位可见 */
+    payload        = new char[payloadSize + PATTERN_PERIOD];
+    uint32_t state = 0x2545F491;
+    for (size_t i = 0; i < payloadSize + PATTERN_PERIOD; ++i) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        payload[i] = (char)state;
+    }
     logInfo(0, logfp, "PressureGenerator - generator - generate %zd bytes payload", payloadSize);
 }
 
 int PressureGenerator::doit(const char* ip, const char* port) {
     /* 初始化服务器地址结构 */
-    bzero(&servaddr, sizeof(servaddr));
-    servaddr.sin_family = AF_INET;
-    if (inetPton(AF_INET, ip, &servaddr.sin_addr, logfp) < 0)
+    bzero(&shared.servaddr, sizeof(shared.servaddr));
+    shared.servaddr.sin_family = AF_INET;
+    if (inetPton(AF_INET, ip, &shared.servaddr.sin_addr, logfp) < 0)
         return -1;
-    if (setPort(port, &servaddr.sin_port, logfp) < 0)
+    if (setPort(port, &shared.servaddr.sin_port, logfp) < 0)
         return -1;
+    shared.payload     = payload;
+    shared.sizes       = &sizes;
+    shared.maxPayload  = payloadSize;
+    shared.burstOn     = (uint64_t)(config.burstOn * 1000000);
+    shared.burstOff    = (uint64_t)(config.burstOff * 1000000);
+    shared.interval    = config.rate > 0 ? (uint64_t)(NANO_SEC / config.rate) : 0;
+    shared.cliCount    = cliCount;
+    shared.exitFlag    = &exitFlag;
+    shared.sampling    = series.isOpen();
 
-    /* 创建epoll事件表描述符 */
-    struct epoll_event events[MAX_EVENT_NUMBER];
-    epollfd = epoll_create(1);
-    assert(epollfd >= 0);
+    /* 启动Worker线程 */
+    rampStart = std::chrono::steady_clock::now();
+    if (startWorkers() < 0) {
+        shared.stopFlag = 1;
+    }
 
-    while (true) {
-        /* 添加新客户端 */
-        if (clients.size() < cliCount && uncnNum < WAIT_CONN_MAX && shutFlag == 0) {
-            if (addClients(events) < 0) {
-                logInfo(0, logfp, "PressureGenerator - generator - too many errors during adding clients");
-                shutdownAll();
-            }
+    /* 等待所有Worker结束，收到信号时记录log，连接阶段每秒报告一次建立的连接数。
+     * 输出时间序列时，每个采样间隔开始一次采样，等所有Worker都发布了采样再写一行。
+     * Worker一轮事件循环可能很长，行的时间取实际取得采样的时间，错过的间隔不补 */
+    typedef std::chrono::steady_clock::duration Duration;
+    size_t   lastConnected = 0;
+    auto     nextReport    = rampStart + std::chrono::seconds(1);
+    Duration interval      = std::chrono::duration_cast<Duration>(std::chrono::duration<double>(config.seriesInterval));
+    auto     nextSample    = rampStart + interval;
+    uint64_t epoch         = 0;
+    int      pending       = 0;
+    auto     sampled       = [&epoch](Worker* worker) { return worker->hasSampled(epoch); };
+    while (shared.running > 0) {
+        if (exitFlag && intFlag)
+            intFlag = logInfo(0, logfp, "PressureGenerator - generator - received SIGINT signal");
+        if (exitFlag && alrmFlag)
+            alrmFlag = logInfo(0, logfp, "PressureGenerator - generator - received SIGALARM signal");
+        if (lastConnected < cliCount && std::chrono::steady_clock::now() >= nextReport) {
+            reportRamp(&lastConnected);
+            nextReport += std::chrono::seconds(1);
         }
-        /* 等待事件 */
-        int ready = epoll_wait(epollfd, events, MAX_EVENT_NUMBER, -1);
-        if (ready < 0) {
-            logError(0, logfp, "PressureGenerator - generator - epoll_wait error");
-            shutdownAll();
+        if (shared.sampling && pending == 0 && std::chrono::steady_clock::now() >= nextSample) {
+            shared.sampleEpoch.store(++epoch, std::memory_order_release);
+            pending = 1;
         }
-        /* 处理事件 */
-        if (handleEvents(events, ready) < 0) {
-            shutdownAll();
-        }
-        if (exitFlag || shutFlag) {
-            shutdownAll();
-            if (clients.size() == 0) {
-                logInfo(0, logfp, "PressureGenerator - generator - all connected sockets are closed");
-                break;
+        if (pending && std::all_of(workers.begin(), workers.end(), sampled)) {
+            auto now = std::chrono::steady_clock::now();
+            writeSample(std::chrono::duration<double>(now - rampStart).count());
+            pending = 0;
+            while (nextSample <= now) {
+                nextSample += interval;
             }
         }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
     }
 
-    return 0;
-}
+    /* 最后一行包含各Worker退出前发布的剩余数据 */
+    if (shared.sampling) {
+        writeSample(std::chrono::duration<double>(std::chrono::steady_clock::now() - rampStart).count());
+    }
 
-int PressureGenerator::addClients(struct epoll_event* events) {
-    int errorTimes = ERROR_MAX;
-    int connTimes  = CONN_SIZE;
-    while (clients.size() < cliCount && connTimes > 0) {
-        int sockfd;
-        if ((sockfd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
-            logError(0, logfp, "PressureGenerator - generator - socket error");
-            errorTimes--;
-            if (errorTimes < 0) {
-                return -1;
-            }
-            continue;
-        }
-        setnonblocking(sockfd); /* 非阻塞 */
-        errno   = 0;
-        int ret = 0;
-        if ((ret = connect(sockfd, (struct sockaddr*)&servaddr, sizeof(servaddr))) < 0) {
-            if (errno != EINPROGRESS) {
-                logError(0, logfp, "PressureGenerator - client %d - connect error", sockfd);
-                close(sockfd);
-                errorTimes--;
-                if (errorTimes < 0) {
-                    return -1;
-                }
-                continue;
-            }
-            else {
-                addOneClient(sockfd, -1);
-            }
-        }
-        /* 直接连接建立 */
-        else {
-            addOneClient(sockfd, 0);
-            logInfo(0, logfp, "PressureGenerator - client %d - new client (c:%zd u:%zd a:%zd)[1]", sockfd, connNum,
-                    uncnNum, connNum + uncnNum);
-        }
-        connTimes--;
+    /* 汇总各Worker的结果，结束时间取最后一个停止发送的Worker */
+    for (Worker* worker : workers) {
+        worker->join();
+        addStatistics(&total, &worker->statistics());
+        latency.merge(worker->latencyHistogram());
+        connectLatency.merge(worker->connectHistogram());
+        endTime = std::max(endTime, worker->stopTime());
     }
+    recordFlag = shared.recordFlag;
+    startTime  = shared.startTime;
+    logInfo(0, logfp, "PressureGenerator - generator - all connected sockets are closed");
     return 0;
 }
 
-void PressureGenerator::addOneClient(int sockfd, int state) {
-    assert(state == 0 || state == -1);
-    assert(clients.find(sockfd) == clients.end());
-    ClientInfo client;
-    client.connfd = sockfd;
-    client.state  = state;
-    if (state == 0) {
-        client.buffer          = new ClientBuffer;
-        client.buffer->sendPtr = this->payload;
-        ++connNum;
-    }
-    else {
-        ++uncnNum;
-    }
-    clients[sockfd] = client;
-    addfd(epollfd, sockfd, 1, 0); /* 添加套接字到epoll事件表 */
+/* 输出这一秒新建立的连接数，即客户端看到的服务器accept速率 */
+void PressureGenerator::reportRamp(size_t* lastConnected) {
+    size_t connected = shared.connected.load();
+    logInfo(0, logfp, "PressureGenerator - generator - %zd/%zd clients connected, %zd/s", connected, cliCount,
+            connected - *lastConnected);
+    printf("connected: %zd/%zd (%zd/s)\n", connected, cliCount, connected - *lastConnected);
+    fflush(stdout);
+    *lastConnected = connected;
 }
 
-void PressureGenerator::shutdownAll() {
-    if (exitFlag && intFlag)
-        intFlag = logInfo(0, logfp, "PressureGenerator - generator - received SIGINT signal");
-    if (exitFlag && alrmFlag)
-        alrmFlag = logInfo(0, logfp, "PressureGenerator - generator - received SIGALARM signal");
-    if (shutFlag == 0) {
-        endTime = std::chrono::steady_clock::now();
-        logInfo(0, logfp, "PressureGenerator - generator - all clients send FIN to server");
-    }
-    shutFlag = 1;
-    for (auto& cli : clients) {
-        if (cli.second.state == 0) {
-            shutdown(cli.first, SHUT_WR);
-            cli.second.state = 1;
-        }
+/* 汇总各Worker发布的采样，写一行时间序列 */
+void PressureGenerator::writeSample(double time) {
+    Statistics sample;
+    size_t     connected = 0, connecting = 0;
+    for (Worker* worker : workers) {
+        worker->takeSample(&sample, &connected, &connecting, &seriesLatency);
     }
+    series.write(time, sample, connected, connecting, seriesLatency);
+    seriesLatency.reset();
 }
 
-int PressureGenerator::handleEvents(struct epoll_event* events, const int& number) {
-    for (int i = 0; i < number; ++i) {
-        int continueFlag = 0;
-        int sockfd       = events[i].data.fd;
-        assert(clients.find(sockfd) != clients.end());
-        /* 如果是未连接套接字 */
-        if (clients[sockfd].state == -1) {
-            int       error;
-            socklen_t len = sizeof(error);
-            if (getsockopt(sockfd, SOL_SOCKET, SO_ERROR, &error, &len) != 0) {
-                errno = 0;
-                logError(-1, logfp, "PressureGenerator - client %d - connect error: %s", sockfd, strerror(error));
-                removeClient(sockfd);
-                continue;
-            }
-            clients[sockfd].state           = 0;                /* 设置状态为已连接(等待接收头部) */
-            clients[sockfd].buffer          = new ClientBuffer; /* 分配缓冲区 */
-            clients[sockfd].buffer->sendPtr = this->payload;
-            ++connNum;
-            --uncnNum;
-            logInfo(0, logfp, "PressureGenerator - client %d - new client (c:%zd u:%zd a:%zd)[2]", sockfd, connNum,
-                    uncnNum, connNum + uncnNum);
-            if (recordFlag == 0 && connNum >= cliCount) {
-                recordFlag = 1;
-                logInfo(0, logfp, "PressureGenerator - generator - %zd connected clients, start to send packets",
-                        connNum);
-                startTime = std::chrono::steady_clock::now();
-            }
-        }
-        /* 初始检查与设置 */
-        assert(clients[sockfd].state != -1);
-        assert(clients[sockfd].buffer != nullptr);
-        assert(clients[sockfd].buffer->sendPtr != nullptr);
-        ClientBuffer* buffer = clients[sockfd].buffer;
-        /* 如果可读，并且有空间容纳 */
-        if (events[i].events & EPOLLIN) {
-            /* 不断地读取，直到没有数据可读 */
-            while (true) {
-                buffer->recved = 0;
-                ssize_t n      = recv(sockfd, buffer->usrBuf, BUFFER_SIZE, 0);
-                if (n > 0) {
-                    g_recvSuccess++;
-                    g_recvBytes += n;
-                    while (true) {
-                        /* 报头或载荷接收完毕 */
-                        if ((size_t)n >= buffer->unrecv) {
-                            // 处理报头
-                            if (buffer->recvFlag == 0) {
-                                memcpy((char*)&buffer->recvHeader + (sizeof(Header) - buffer->unrecv),
-                                       buffer->usrBuf + buffer->recved, buffer->unrecv);
-                                size_t msgLen = (size_t)handleHeader(&buffer->recvHeader, sockfd);
-                                g_recvPackets++; /* 报文数加1 */
-                                n                = n - buffer->unrecv;
-                                buffer->recved   = buffer->recved + buffer->unrecv;
-                                buffer->recvFlag = 1;
-                                buffer->unrecv   = msgLen;
-                            }
-                            // 处理载荷
-                            else {
-                                n                = n - buffer->unrecv;
-                                buffer->recved   = buffer->recved + buffer->unrecv;
-                                buffer->recvFlag = 0;
-                                buffer->unrecv   = sizeof(Header);
-                            }
-                        }
-                        /* 只接受了一部分 */
-                        else {
-                            if (buffer->recvFlag == 0) {
-                                memcpy((char*)&buffer->recvHeader + (sizeof(Header) - buffer->unrecv),
-                                       buffer->usrBuf + buffer->recved, n);
-                            }
-                            buffer->unrecv = buffer->unrecv - n;
-                            buffer->recved = buffer->recved + n;
-                            break;
-                        }
-                    }
-                }
-                else if (n == 0) {
-                    g_recvFINs++;
-                    logInfo(0, logfp, "PressureGenerator - client %d - receive FIN from server", sockfd);
-                    if (clients[sockfd].state == 0) { /* 之前未关闭连接，则直接关闭写 */
-                        shutdown(sockfd, SHUT_WR);
-                    }
-                    else {
-                        shutdown(sockfd, SHUT_RD); /* 之前关闭了写，则把读关闭 */
-                    }
-                    /* 直接关闭写的一端，不再写了，因为数据可能源源不断地来，我们不知道还得写多少 */
-                    removeClient(sockfd);
-                    continueFlag = 1;
-                    break;
-                }
-                else {
-                    if (errno != EWOULDBLOCK) { /* 连接已经结束，直接close套接字 */
-                        g_recvError++;
-                        logError(-1, logfp, "PressureGenerator - client %d - recv error", sockfd);
-                        removeClient(sockfd);
-                        continueFlag = 1;
-                    }
-                    else {
-                        g_recvEAGAIN++;
-                    }
-                    break; /* 读到没有数据了，退出 */
-                }
-            }
-            if (continueFlag) {
-                continue; /* continue最外层的for */
-            }
-        }
-        /* 有空间可以发送数据，并且要开始记录才能发送数据，并且不能是关闭了写的一端 */
-        if ((events[i].events & EPOLLOUT) && recordFlag == 1 && clients[sockfd].state != 1) {
-            while (true) {
-                ssize_t n = 0;
-                if (buffer->sended < sizeof(Header)) {
-                    if (buffer->sended == 0) {
-                        getHeader(payloadSize, sockfd, &buffer->sendHeader);
-                        g_sendPackets++;
-                    }
-                    n = send(sockfd, (char*)&buffer->sendHeader + buffer->sended, sizeof(Header) - buffer->sended, 0);
-                }
-                else {
-                    n = send(sockfd, buffer->sendPtr + buffer->sended - sizeof(Header),
-                             payloadSize - (buffer->sended - sizeof(Header)), 0);
-                }
-                if (n >= 0) {
-                    g_sendSuccess++;
-                    g_sendBytes += n;
-                    buffer->sended += n;
-                    if (buffer->sended == sizeof(Header) + payloadSize) {
-                        buffer->sended = 0;
-                    }
-                }
-                else { /* 遇到错误 */
-                    if (errno != EWOULDBLOCK) {
-                        g_sendError++;
-                        logError(-1, logfp, "PressureGenerator - client %d - send error", sockfd);
-                        removeClient(sockfd);
-                        continueFlag = 1;
-                    }
-                    else {
-                        g_sendEAGAIN++;
-                    }
-                    break; /* 写到不能写了，退出 */
-                }
-            }
-            if (continueFlag) {
-                continue; /* continue最外层的for */
-            }
-        }
-    }
-    return 0;
+/* 实际发出的报文的平均大小（包括报头），最后一个报文可能没有发完 */
+double PressureGenerator::averagePacketSize() const {
+    return total.sendPackets > 0 ? (double)total.sendBytes / total.sendPackets : sizes.mean();
 }
 
-int PressureGenerator::removeClient(const int& sockfd) {
-    assert(clients.find(sockfd) != clients.end());
-    if (clients[sockfd].state == -1) {
-        uncnNum--;
-    }
-    else {
-        connNum--;
-    }
-    if (clients[sockfd].buffer != nullptr)
-        delete clients[sockfd].buffer;
-    clients.erase(sockfd);
-    if (close(sockfd) < 0) {
-        logError(-1, logfp, "PressureGenerator - client %d - close error", sockfd);
+int PressureGenerator::startWorkers() {
+    /* Worker线程屏蔽SIGINT和SIGALRM，由主线程处理 */
+    sigset_t mask, oldMask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    sigaddset(&mask, SIGALRM);
+    pthread_sigmask(SIG_BLOCK, &mask, &oldMask);
+    int    r       = 0;
+    size_t threads = std::min((size_t)config.threads, cliCount / 2);
+
+    shared.connRate  = config.connRate / threads;
+    shared.connBurst = config.connBurst;
+    /* 每轮最多发起connBurst个连接，允许两轮的连接同时进行，建立连接较慢时下一轮仍能继续发起 */
+    shared.connPending = config.connPending > 0 ? (size_t)config.connPending
+                                                : (size_t)std::max(CONN_PENDING_MIN, config.connBurst * 2);
+    for (size_t i = 0; i < threads; ++i) {
+        /* 按会话平均分配，前cliCount / 2 % threads个Worker多分一个会话 */
+        size_t sessions = cliCount / 2 / threads + (i < cliCount / 2 % threads ? 1 : 0);
+        Worker* worker  = new Worker((int)i, sessions * 2, &shared, logfp);
+        workers.push_back(worker);
+        if (worker->start() < 0) {
+            r = -1;
+            break;
+        }
     }
-    delfd(epollfd, sockfd);
-    logInfo(0, logfp, "PressureGenerator - client %d - client left (c:%zd u:%zd a:%zd)", sockfd, connNum, uncnNum,
-            connNum + uncnNum);
-    return 0;
+    pthread_sigmask(SIG_SETMASK, &oldMask, NULL);
+    logInfo(0, logfp, "PressureGenerator - generator - %zd worker threads started", workers.size());
+    return r;
 }
 
 void PressureGenerator::sigIntHandler(int signum) {
@@ -441,72 +383,6 @@ sigfunc* PressureGenerator::signal(int signo, sigfunc* func) {
     return (oact.sa_handler);
 }
 
-uint16_t PressureGenerator::handleHeader(struct Header* header, const int& sockfd) {
-    uint16_t        msgLen = ntohs(header->length);
-    struct timespec timestamp;
-    timestamp.tv_sec  = ntoh64(header->sec);
-    timestamp.tv_nsec = ntoh64(header->nsec);
-    if (timestamp.tv_nsec >= NANO_SEC) {
-        perror("receive time wrong");
-    }
-    addDelay(&timestamp);
-    // logInfo(0, logfp, "PressureGenerator - client %d - recv header: <length: %hd, id: %d, time: %s>", sockfd, msgLen,
-    //         ntohl(header->id), strftTime(&timestamp).c_str());
-    return msgLen;
-}
-
-// void PressureGenerator::addDelay(struct timespec* timestamp) {
-//     struct timespec timeNow;
-//     clock_gettime(CLOCK_REALTIME, &timeNow);
-//     assert(timestamp->tv_nsec < NANO_SEC);
-//     if (timeNow.tv_sec < timestamp->tv_sec) {
-//         return;
-//     }
-//     else if (timeNow.tv_sec == timestamp->tv_sec) {
-//         if (timeNow.tv_nsec < timestamp->tv_nsec) {
-//             return;
-//         }
-//         else {
-//             g_totalDelay.tv_nsec += (timeNow.tv_nsec - timestamp->tv_nsec);
-//             if (g_totalDelay.tv_nsec > NANO_SEC) {
-//                 g_totalDelay.tv_sec += g_totalDelay.tv_nsec / NANO_SEC;
-//                 g_totalDelay.tv_nsec %= NANO_SEC;
-//             }
-//         }
-//     }
-//     else {
-//         g_totalDelay.tv_sec += (timeNow.tv_sec - timestamp->tv_sec);
-//         if (timeNow.tv_nsec < timestamp->tv_nsec) {
-//             if (g_totalDelay.tv_nsec > (timestamp->tv_nsec - timeNow.tv_nsec)) {
-//                 g_totalDelay.tv_nsec -= (timestamp->tv_nsec - timeNow.tv_nsec);
-//             }
-//             else {
-//                 g_totalDelay.tv_nsec = NANO_SEC - ((timestamp->tv_nsec - timeNow.tv_nsec) - g_totalDelay.tv_nsec);
-//                 g_totalDelay.tv_sec--;
-//             }
-//         }
-//         else {
-//             g_totalDelay.tv_nsec += (timeNow.tv_nsec - timestamp->tv_nsec);
-//             if (g_totalDelay.tv_nsec > NANO_SEC) {
-//                 g_totalDelay.tv_sec += g_totalDelay.tv_nsec / NANO_SEC;
-//                 g_totalDelay.tv_nsec %= NANO_SEC;
-//             }
-//         }
-//     }
-// }
-
-void PressureGenerator::addDelay(struct timespec* timestamp) {
-    struct timespec timeNow;
-    clock_gettime(CLOCK_REALTIME, &timeNow);
-    assert(timestamp->tv_nsec < NANO_SEC);
-    if (timestamp->tv_sec > timeNow.tv_sec
-        || (timestamp->tv_sec == timeNow.tv_sec && timestamp->tv_nsec > timeNow.tv_nsec)) {
-        return;
-    }
-    g_totalDelay += (double)(timeNow.tv_sec - timestamp->tv_sec) * 1000
-                    + (double)(timeNow.tv_nsec - timestamp->tv_nsec) / (NANO_SEC / 1000);
-}
-
 void PressureGenerator::prepareExit() {
     if (payload != nullptr) {
         delete[] payload;
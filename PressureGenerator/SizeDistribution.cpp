@@ -0,0 +1,118 @@
+#include "SizeDistribution.hpp"
+#include <algorithm>
+#include <cmath>
+
+int SizeDistribution::parse(const char* str) {
+    spec = str;
+    values.clear();
+    cumulative.clear();
+    uniform = 0;
+    size_t a, b;
+    double p;
+    int    n = 0;
+    if ((sscanf(str, "%zu%n", &a, &n) == 1 || sscanf(str, "fixed:%zu%n", &a, &n) == 1) && str[n] == '\0') {
+        addValue(a, 1);
+    }
+    else if (sscanf(str, "uniform:%zu:%zu%n", &a, &b, &n) == 2 && str[n] == '\0') {
+        if (a > b) {
+            return -1;
+        }
+        uniform  = 1;
+        minSize  = a;
+        maxSize  = b;
+        meanSize = ((double)a + b) / 2;
+        return 0;
+    }
+    else if (sscanf(str, "bimodal:%zu:%zu:%lf%n", &a, &b, &p, &n) == 3 && str[n] == '\0') {
+        if (p < 0 || p > 1) {
+            return -1;
+        }
+        addValue(a, 1 - p);
+        addValue(b, p);
+    }
+    else if (sscanf(str, "zipf:%zu:%zu:%lf%n", &a, &b, &p, &n) == 3 && str[n] == '\0') {
+        if (a > b || p < 0) {
+            return -1;
+        }
+        for (size_t k = 0; k <= b - a; ++k) {
+            addValue(a + k, 1 / std::pow((double)(k + 1), p));
+        }
+    }
+    else if (strncmp(str, "file:", 5) == 0) {
+        if (loadFile(str + 5) < 0) {
+            return -1;
+        }
+    }
+    else {
+        return -1;
+    }
+    return finish();
+}
+
+/* 追加一个取值，权重为0的取值不会被抽到，直接忽略 */
+int SizeDistribution::addValue(size_t value, double weight) {
+    if (!(weight >= 0)) {
+        return -1;
+    }
+    if (weight > 0) {
+        values.push_back(value);
+        cumulative.push_back((cumulative.empty() ? 0 : cumulative.back()) + weight);
+    }
+    return 0;
+}
+
+/* 把累积权重归一化，并计算最小值、最大值和期望 */
+int SizeDistribution::finish() {
+    if (values.empty()) {
+        return -1;
+    }
+    double total = cumulative.back();
+    double prev  = 0;
+    minSize = maxSize = values[0];
+    meanSize          = 0;
+    for (size_t i = 0; i < values.size(); ++i) {
+        minSize = std::min(minSize, values[i]);
+        maxSize = std::max(maxSize, values[i]);
+        meanSize += values[i] * (cumulative[i] - prev) / total;
+        prev          = cumulative[i];
+        cumulative[i] = cumulative[i] / total;
+    }
+    cumulative.back() = 1;
+    return 0;
+}
+
+int SizeDistribution::loadFile(const char* path) {
+    FILE* fp = fopen(path, "r");
+    if (fp == nullptr) {
+        return -1;
+    }
+    char line[LINE_MAX];
+    int  r = 0;
+    while (r == 0 && fgets(line, LINE_MAX, fp) != nullptr) {
+        size_t value;
+        double weight;
+        char*  start = line + strspn(line, " \t");
+        if (*start == '#' || *start == '\n' || *start == '\0') {
+            continue;
+        }
+        if (sscanf(start, "%zu %lf", &value, &weight) != 2) {
+            r = -1;
+        }
+        else {
+            r = addValue(value, weight);
+        }
+    }
+    fclose(fp);
+    return r;
+}
+
+size_t SizeDistribution::sample(uint64_t* rng) const {
+    if (uniform) {
+        return minSize + nextRandom(rng) % (maxSize - minSize + 1);
+    }
+    if (values.size() == 1) {
+        return values[0];
+    }
+    size_t i = std::upper_bound(cumulative.begin(), cumulative.end(), nextUniform(rng)) - cumulative.begin();
+    return values[std::min(i, values.size() - 1)];
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "../common/common.hpp"
+#include <string>
+#include <vector>
+
+/* xorshift64*伪随机数，每个Worker一个状态，不需要加锁 */
+inline uint64_t nextRandom(uint64_t* state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545F4914F6CDD1DULL;
+}
+
+/* [0, 1)上均匀分布的随机数 */
+inline double nextUniform(uint64_t* state) {
+    return (double)(nextRandom(state) >> 11) / (double)(1ULL << 53);
+}
+
+/* 报文大小（包括报头）的分布，由字符串描述：
+ *   N 或 fixed:N                   固定大小
+ *   uniform:MIN:MAX               [MIN, MAX]上均匀分布
+ *   bimodal:SMALL:LARGE:P         以概率P取LARGE，否则取SMALL
+ *   zipf:MIN:MAX:S                第k小的大小（k从1开始）的概率正比于1/k^S
+ *   file:PATH                     经验分布，文件每行为“大小 权重”，#开头的行为注释
+ * 除uniform外都转换成离散分布，按累积概率二分查找抽样 */
+class SizeDistribution {
+private:
+    std::string         spec;              /* 描述字符串 */
+    int                 uniform  = 0;      /* 是否是均匀分布 */
+    size_t              minSize  = 0;      /* 最小值 */
+    size_t              maxSize  = 0;      /* 最大值 */
+    double              meanSize = 0;      /* 期望 */
+    std::vector<size_t> values;            /* 离散分布的取值 */
+    std::vector<double> cumulative;        /* 离散分布的累积概率，最后一项为1 */
+
+    int addValue(size_t value, double weight);
+    int finish();
+    int loadFile(const char* path);
+
+public:
+    /* 解析描述字符串，格式错误返回-1 */
+    int parse(const char* spec);
+
+    /* 抽取一个报文大小 */
+    size_t sample(uint64_t* rng) const;
+
+    size_t min() const {
+        return minSize;
+    }
+
+    size_t max() const {
+        return maxSize;
+    }
+
+    double mean() const {
+        return meanSize;
+    }
+
+    const char* describe() const {
+        return spec.c_str();
+    }
+};
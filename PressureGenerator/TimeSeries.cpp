@@ -0,0 +1,53 @@
+#include "TimeSeries.hpp"
+
+#define SERIES_CSV_HEADER                                                                                           \
+    "time,interval,connected,connecting,connectErrors,sendBytes,sendPackets,recvBytes,recvPackets,recvLost,"       \
+    "recvCorrupted,latencyCount,p50Delay,p90Delay,p99Delay,p999Delay,maxDelay\n"
+
+static int endsWith(const char* str, const char* suffix) {
+    size_t n = strlen(str), m = strlen(suffix);
+    return n >= m && strcmp(str + n - m, suffix) == 0;
+}
+
+int TimeSeries::open(const char* path) {
+    fp = fopen(path, "w");
+    if (fp == nullptr) {
+        return -1;
+    }
+    json = endsWith(path, ".json") || endsWith(path, ".jsonl");
+    if (json == 0) {
+        fputs(SERIES_CSV_HEADER, fp);
+    }
+    return 0;
+}
+
+void TimeSeries::write(double time, const Statistics& stats, size_t connected, size_t connecting,
+                       const LatencyHistogram& latency) {
+    if (fp == nullptr) {
+        return;
+    }
+    /* 计数都是这个间隔内的增量，延迟单位为毫秒 */
+    const char* format = json ? "{\"time\":%.3lf,\"interval\":%.3lf,\"connected\":%zu,\"connecting\":%zu,"
+                                "\"connectErrors\":%lu,\"sendBytes\":%lu,\"sendPackets\":%lu,\"recvBytes\":%lu,"
+                                "\"recvPackets\":%lu,\"recvLost\":%lu,\"recvCorrupted\":%lu,\"latencyCount\":%lu,"
+                                "\"p50Delay\":%.3lf,\"p90Delay\":%.3lf,\"p99Delay\":%.3lf,\"p999Delay\":%.3lf,"
+                                "\"maxDelay\":%.3lf}\n"
+                              : "%.3lf,%.3lf,%zu,%zu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%lu,%.3lf,%.3lf,%.3lf,%.3lf,%.3lf\n";
+    fprintf(fp, format, time, time - lastTime, connected, connecting, stats.connectErrors - last.connectErrors,
+            stats.sendBytes - last.sendBytes, stats.sendPackets - last.sendPackets, stats.recvBytes - last.recvBytes,
+            stats.recvPackets - last.recvPackets, stats.recvLost - last.recvLost,
+            stats.recvCorrupted - last.recvCorrupted, latency.count(), (double)latency.percentile(50) / 1000000,
+            (double)latency.percentile(90) / 1000000, (double)latency.percentile(99) / 1000000,
+            (double)latency.percentile(99.9) / 1000000, (double)latency.max() / 1000000);
+    /* 每行立即写出，运行中就可以用tail -f观察 */
+    fflush(fp);
+    lastTime = time;
+    last     = stats;
+}
+
+void TimeSeries::close() {
+    if (fp != nullptr) {
+        fclose(fp);
+        fp = nullptr;
+    }
+}
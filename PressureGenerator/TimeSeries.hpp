@@ -0,0 +1,32 @@
+#pragma once
+
+#include "LatencyHistogram.hpp"
+#include "Worker.hpp"
+
+/* 运行过程中按固定间隔输出的时间序列：每行是一个间隔内的发送、接收量，报文延迟百分位和连接数，
+ * 用来观察预热、吞吐骤降和服务器卡顿，而不是只看整个运行的平均值 */
+class TimeSeries {
+private:
+    FILE*      fp       = nullptr; /* 输出文件 */
+    int        json     = 0;       /* 1: JSON lines，0: CSV */
+    double     lastTime = 0;       /* 上一行的时间 */
+    Statistics last;               /* 上一行时各Worker的累计统计之和 */
+
+public:
+    ~TimeSeries() {
+        close();
+    }
+
+    /* 打开输出文件，扩展名为.json或.jsonl时输出JSON lines，否则输出带表头的CSV */
+    int open(const char* path);
+
+    /* 输出一行：time为距开始发起连接的秒数，stats为累计统计，latency只包含这个间隔内收到的报文 */
+    void write(double time, const Statistics& stats, size_t connected, size_t connecting,
+               const LatencyHistogram& latency);
+
+    void close();
+
+    bool isOpen() const {
+        return fp != nullptr;
+    }
+};
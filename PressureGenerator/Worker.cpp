@@ -0,0 +1,709 @@
+#include "Worker.hpp"
+#include <cmath>
+
+#define ERROR_MAX 10
+
+void addStatistics(Statistics* dst, const Statistics* src) {
+    dst->totalDelay += src->totalDelay;
+    dst->recvBytes += src->recvBytes;
+    dst->recvPackets += src->recvPackets;
+    dst->recvSuccess += src->recvSuccess;
+    dst->recvEAGAIN += src->recvEAGAIN;
+    dst->recvError += src->recvError;
+    dst->recvFINs += src->recvFINs;
+    dst->sendBytes += src->sendBytes;
+    dst->sendPackets += src->sendPackets;
+    dst->sendSuccess += src->sendSuccess;
+    dst->sendEAGAIN += src->sendEAGAIN;
+    dst->sendError += src->sendError;
+    dst->sendLate += src->sendLate;
+    dst->connectErrors += src->connectErrors;
+    dst->connectCapped += src->connectCapped;
+    dst->recvLost += src->recvLost;
+    dst->recvReordered += src->recvReordered;
+    dst->recvCorrupted += src->recvCorrupted;
+}
+
+/* 报文序号和载荷长度的校验和，用来发现PacketTag本身被破坏 */
+static uint64_t tagChecksum(uint64_t seq, uint64_t length) {
+    uint64_t h = (seq ^ 0x9E3779B97F4A7C15ULL) * 0xBF58476D1CE4E5B9ULL;
+    h ^= (h >> 31) + length;
+    return h * 0x94D049BB133111EBULL;
+}
+
+/* 当前时间（纳秒），默认使用与报头中的时间戳相同的CLOCK_REALTIME */
+static uint64_t nowNanoseconds(clockid_t clock = CLOCK_REALTIME) {
+    struct timespec now;
+    clock_gettime(clock, &now);
+    return (uint64_t)now.tv_sec * NANO_SEC + now.tv_nsec;
+}
+
+Worker::~Worker() {
+    join();
+    for (auto& cli : clients) {
+        delete cli.second.buffer;
+        close(cli.first);
+    }
+    if (timerfd >= 0) {
+        close(timerfd);
+    }
+    if (epollfd >= 0) {
+        close(epollfd);
+    }
+}
+
+int Worker::start() {
+    epollfd = epoll_create(1);
+    if (epollfd < 0) {
+        return logError(-1, logfp, "PressureGenerator - worker %d - epoll_create error", index);
+    }
+    /* 开环模式用timerfd在计划时间唤醒epoll_wait，突发模式用它结束关阶段 */
+    if (shared->interval > 0 || shared->burstOn > 0) {
+        timerfd = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK | TFD_CLOEXEC);
+        if (timerfd < 0) {
+            return logError(-1, logfp, "PressureGenerator - worker %d - timerfd_create error", index);
+        }
+        addfd(epollfd, timerfd, 0, 0);
+    }
+    events.resize(std::min(cliCount + 1, (size_t)MAX_EVENT_NUMBER));
+    rng = (uint64_t)(index + 1) * 0x9E3779B97F4A7C15ULL;
+    shared->running++;
+    thread = std::thread(&Worker::run, this);
+    return 0;
+}
+
+void Worker::join() {
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+void Worker::run() {
+    logInfo(0, logfp, "PressureGenerator - worker %d - start with %zd clients", index, cliCount);
+    while (true) {
+        /* 添加新客户端 */
+        if (clients.size() < cliCount && shutFlag == 0) {
+            if (addClients() < 0) {
+                logInfo(0, logfp, "PressureGenerator - worker %d - too many errors during adding clients", index);
+                shared->stopFlag = 1;
+                shutdownAll();
+            }
+        }
+        /* 等待事件 */
+        int ready = epoll_wait(epollfd, events.data(), (int)events.size(), waitTimeout());
+        if (ready < 0) {
+            if (errno != EINTR) {
+                logError(0, logfp, "PressureGenerator - worker %d - epoll_wait error", index);
+                shared->stopFlag = 1;
+                shutdownAll();
+            }
+            ready = 0;
+        }
+        /* 处理事件 */
+        if (handleEvents(ready) < 0) {
+            shutdownAll();
+        }
+        /* 开环模式：所有客户端连接后安排第一个报文，之后按计划发送；突发模式：恢复关阶段结束的客户端 */
+        if (timerfd >= 0 && shutFlag == 0 && shared->recordFlag.load(std::memory_order_acquire) == 1) {
+            if (shared->interval > 0 && scheduled == 0) {
+                scheduleAll();
+            }
+            sendDue();
+            armTimer();
+        }
+        /* 主线程开始了新的采样间隔 */
+        if (shared->sampling && shared->sampleEpoch.load(std::memory_order_acquire) != sampleEpoch) {
+            publishSample();
+        }
+        if (*shared->exitFlag || shared->stopFlag || shutFlag) {
+            shutdownAll();
+            if (clients.size() == 0) {
+                logInfo(0, logfp, "PressureGenerator - worker %d - all connected sockets are closed", index);
+                break;
+            }
+        }
+    }
+    if (shared->sampling) {
+        publishSample();
+    }
+    published.store(UINT64_MAX, std::memory_order_release);
+    shared->running--;
+}
+
+/* 把当前的累计统计和上次发布之后的延迟交给主线程，主线程取走之前可能发布多次，延迟会累积 */
+void Worker::publishSample() {
+    sampleEpoch = shared->sampleEpoch.load(std::memory_order_acquire);
+    {
+        std::lock_guard<std::mutex> lock(sampleMutex);
+        sampleStats   = stats;
+        sampleConnNum = connNum;
+        sampleUncnNum = uncnNum;
+        sampleLatency.merge(recentLatency);
+    }
+    recentLatency.reset();
+    published.store(sampleEpoch, std::memory_order_release);
+}
+
+void Worker::takeSample(Statistics* stats, size_t* connected, size_t* connecting, LatencyHistogram* latency) {
+    std::lock_guard<std::mutex> lock(sampleMutex);
+    addStatistics(stats, &sampleStats);
+    *connected += sampleConnNum;
+    *connecting += sampleUncnNum;
+    latency->merge(sampleLatency);
+    sampleLatency.reset();
+}
+
+/* 最后一个客户端连接成功时开始发送报文 */
+void Worker::onConnected() {
+    if (shared->connected.fetch_add(1) + 1 == shared->cliCount) {
+        shared->startTime = std::chrono::steady_clock::now();
+        shared->recordFlag.store(1, std::memory_order_release);
+        logInfo(0, logfp, "PressureGenerator - generator - %zd connected clients, start to send packets",
+                shared->cliCount);
+    }
+}
+
+void Worker::shutdownAll() {
+    if (shutFlag == 0) {
+        endTime = std::chrono::steady_clock::now();
+        logInfo(0, logfp, "PressureGenerator - worker %d - all clients send FIN to server", index);
+    }
+    shutFlag = 1;
+    for (auto& cli : clients) {
+        if (cli.second.state == 0) {
+            shutdown(cli.first, SHUT_WR);
+            cli.second.state = 1;
+        }
+    }
+}
+
+/* 本轮可以发起的连接数：不限速时为connBurst，否则按令牌桶补充，最多攒connBurst个 */
+int Worker::connectQuota() {
+    if (shared->connRate <= 0) {
+        return shared->connBurst;
+    }
+    uint64_t now = nowNanoseconds(CLOCK_MONOTONIC);
+    if (connRefill > 0) {
+        connTokens += (double)(now - connRefill) * shared->connRate / NANO_SEC;
+        connTokens = std::min(connTokens, (double)shared->connBurst);
+    }
+    connRefill = now;
+    return (int)connTokens;
+}
+
+/* epoll_wait的超时时间：还要发起连接时不能等太久，限速时等到下一个令牌 */
+int Worker::waitTimeout() {
+    if (clients.size() >= cliCount || uncnNum >= shared->connPending || shutFlag) {
+        return WORKER_WAIT_MS;
+    }
+    if (shared->connRate <= 0) {
+        return 0;
+    }
+    double ms = (1 - connTokens) * 1000 / shared->connRate;
+    return ms <= 0 ? 0 : std::min((int)ms + 1, WORKER_WAIT_MS);
+}
+
+int Worker::addClients() {
+    int errorTimes = ERROR_MAX;
+    int connTimes  = connectQuota();
+    while (clients.size() < cliCount && uncnNum < shared->connPending && connTimes > 0) {
+        int sockfd;
+        if ((sockfd = socket(AF_INET, SOCK_STREAM, 0)) < 0) {
+            logError(0, logfp, "PressureGenerator - worker %d - socket error", index);
+            stats.connectErrors++;
+            errorTimes--;
+            if (errorTimes < 0) {
+                return -1;
+            }
+            continue;
+        }
+        setnonblocking(sockfd); /* 非阻塞 */
+        errno                 = 0;
+        int      ret          = 0;
+        uint64_t connectStart = nowNanoseconds(CLOCK_MONOTONIC);
+        if (shared->connRate > 0) {
+            connTokens -= 1;
+        }
+        if ((ret = connect(sockfd, (struct sockaddr*)&shared->servaddr, sizeof(shared->servaddr))) < 0) {
+            if (errno != EINPROGRESS) {
+                logError(0, logfp, "PressureGenerator - client %d - connect error", sockfd);
+                stats.connectErrors++;
+                close(sockfd);
+                errorTimes--;
+                if (errorTimes < 0) {
+                    return -1;
+                }
+                continue;
+            }
+            else {
+                addOneClient(sockfd, -1);
+                clients[sockfd].connectStart = connectStart;
+            }
+        }
+        /* 直接连接建立 */
+        else {
+            addOneClient(sockfd, 0);
+            connectLatency.record(nowNanoseconds(CLOCK_MONOTONIC) - connectStart);
+            logInfo(0, logfp, "PressureGenerator - client %d - new client (c:%zd u:%zd a:%zd)[1]", sockfd, connNum,
+                    uncnNum, connNum + uncnNum);
+            onConnected();
+        }
+        connTimes--;
+    }
+    /* 还有配额和未连接的客户端，却因进行中的连接数达到上限而停下，说明建立连接的速度受该上限限制 */
+    if (connTimes > 0 && clients.size() < cliCount && uncnNum >= shared->connPending) {
+        stats.connectCapped++;
+    }
+    return 0;
+}
+
+void Worker::addOneClient(int sockfd, int state) {
+    assert(state == 0 || state == -1);
+    assert(clients.find(sockfd) == clients.end());
+    ClientInfo client;
+    client.connfd = sockfd;
+    client.state  = state;
+    if (state == 0) {
+        client.buffer          = new ClientBuffer;
+        client.buffer->sendPtr = shared->payload;
+        ++connNum;
+    }
+    else {
+        ++uncnNum;
+    }
+    clients[sockfd] = client;
+    /* 添加套接字到epoll事件表，开环模式下已连接的套接字只在发送缓冲区满时关注EPOLLOUT */
+    addfd(epollfd, sockfd, state == -1 || shared->interval == 0, 0);
+}
+
+int Worker::handleEvents(const int& number) {
+    for (int i = 0; i < number; ++i) {
+        int continueFlag = 0;
+        int sockfd       = events[i].data.fd;
+        /* 定时器到期，由sendDue发送到期的报文 */
+        if (sockfd == timerfd) {
+            uint64_t expirations;
+            if (read(timerfd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN) {
+                logError(-1, logfp, "PressureGenerator - worker %d - read timerfd error", index);
+            }
+            armedAt = 0;
+            continue;
+        }
+        assert(clients.find(sockfd) != clients.end());
+        /* 如果是未连接套接字 */
+        if (clients[sockfd].state == -1) {
+            int       error;
+            socklen_t len = sizeof(error);
+            if (getsockopt(sockfd, SOL_SOCKET, SO_ERROR, &error, &len) != 0 || error != 0) {
+                errno = 0;
+                logError(-1, logfp, "PressureGenerator - client %d - connect error: %s", sockfd, strerror(error));
+                stats.connectErrors++;
+                removeClient(sockfd);
+                continue;
+            }
+            connectLatency.record(nowNanoseconds(CLOCK_MONOTONIC) - clients[sockfd].connectStart);
+            clients[sockfd].state           = 0;                /* 设置状态为已连接(等待接收头部) */
+            clients[sockfd].buffer          = new ClientBuffer; /* 分配缓冲区 */
+            clients[sockfd].buffer->sendPtr = shared->payload;
+            ++connNum;
+            --uncnNum;
+            if (shared->interval > 0) {
+                modfd(epollfd, sockfd, 1, 0, 0);
+            }
+            logInfo(0, logfp, "PressureGenerator - client %d - new client (c:%zd u:%zd a:%zd)[2]", sockfd, connNum,
+                    uncnNum, connNum + uncnNum);
+            onConnected();
+        }
+        /* 初始检查与设置 */
+        assert(clients[sockfd].state != -1);
+        assert(clients[sockfd].buffer != nullptr);
+        assert(clients[sockfd].buffer->sendPtr != nullptr);
+        ClientBuffer* buffer = clients[sockfd].buffer;
+        /* 如果可读，并且有空间容纳 */
+        if (events[i].events & EPOLLIN) {
+            /* 不断地读取，直到没有数据可读 */
+            while (true) {
+                buffer->recved = 0;
+                ssize_t n      = recv(sockfd, buffer->usrBuf, BUFFER_SIZE, 0);
+                if (n > 0) {
+                    stats.recvSuccess++;
+                    stats.recvBytes += n;
+                    handleData(buffer, (size_t)n, sockfd);
+                }
+                else if (n == 0) {
+                    stats.recvFINs++;
+                    logInfo(0, logfp, "PressureGenerator - client %d - receive FIN from server", sockfd);
+                    if (clients[sockfd].state == 0) { /* 之前未关闭连接，则直接关闭写 */
+                        shutdown(sockfd, SHUT_WR);
+                    }
+                    else {
+                        shutdown(sockfd, SHUT_RD); /* 之前关闭了写，则把读关闭 */
+                    }
+                    /* 直接关闭写的一端，不再写了，因为数据可能源源不断地来，我们不知道还得写多少 */
+                    removeClient(sockfd);
+                    continueFlag = 1;
+                    break;
+                }
+                else {
+                    if (errno != EWOULDBLOCK) { /* 连接已经结束，直接close套接字 */
+                        stats.recvError++;
+                        logError(-1, logfp, "PressureGenerator - client %d - recv error", sockfd);
+                        removeClient(sockfd);
+                        continueFlag = 1;
+                    }
+                    else {
+                        stats.recvEAGAIN++;
+                    }
+                    break; /* 读到没有数据了，退出 */
+                }
+            }
+            if (continueFlag) {
+                continue; /* continue最外层的for */
+            }
+        }
+        /* 有空间可以发送数据，并且要开始记录才能发送数据，并且不能是关闭了写的一端；
+         * 开环模式下只处理发送缓冲区满之后的EPOLLOUT */
+        if ((events[i].events & EPOLLOUT) && shared->recordFlag.load(std::memory_order_acquire) == 1
+            && clients[sockfd].state != 1 && (shared->interval == 0 || buffer->blocked)) {
+            int r = sendPackets(sockfd, buffer);
+            if (r < 0) {
+                continue; /* continue最外层的for */
+            }
+            /* 开环模式：补发完到期的报文，不再关注EPOLLOUT，回到定时器 */
+            if (shared->interval > 0 && r == 0) {
+                buffer->blocked = 0;
+                modfd(epollfd, sockfd, 1, 0, 0);
+                timers.push(SendTimer(buffer->nextSend, sockfd));
+            }
+        }
+    }
+    return 0;
+}
+
+/* 不断地发送，直到发送缓冲区满（闭环模式下最多SEND_BURST_MAX字节，其余的等下一次EPOLLOUT）；
+ * 每个报文的大小从shared->sizes中抽取，突发模式下关阶段不开始新的报文；
+ * 开环模式下只发送已到计划时间的报文，
+ * 报头中是计划发送时间而不是实际发送时间，发送被推迟的时间也会计入延迟。
+ * 返回-1表示客户端出错已被移除，1表示发送缓冲区已满，0表示到期的报文都已发出 */
+int Worker::sendPackets(const int& sockfd, ClientBuffer* buffer) {
+    uint64_t now   = shared->interval > 0 || shared->burstOn > 0 ? nowNanoseconds() : 0;
+    size_t   burst = 0;
+    while (true) {
+        ssize_t n = 0;
+        if (buffer->sended < sizeof(PacketPrefix)) {
+            if (buffer->prepared == 0) {
+                if (shared->burstOn > 0 && burstPaused(sockfd, buffer, now)) {
+                    return 0;
+                }
+                buffer->sendSize = shared->sizes->sample(&rng) - sizeof(Header);
+                if (shared->interval == 0) {
+                    getHeader(buffer->sendSize, sockfd, &buffer->sendPrefix.header);
+                }
+                else {
+                    if (buffer->nextSend > now) {
+                        return 0; /* 下一个报文还没到计划时间 */
+                    }
+                    if (now - buffer->nextSend > shared->interval) {
+                        stats.sendLate++;
+                    }
+                    struct timespec timestamp;
+                    timestamp.tv_sec  = buffer->nextSend / NANO_SEC;
+                    timestamp.tv_nsec = buffer->nextSend % NANO_SEC;
+                    setHeader(buffer->sendSize, sockfd, &timestamp, &buffer->sendPrefix.header);
+                    buffer->nextSend += shared->interval;
+                }
+                /* 载荷内容随序号轮换起点 */
+                buffer->sendPrefix.tag.seq   = hton64(buffer->sendSeq);
+                buffer->sendPrefix.tag.check = hton64(tagChecksum(buffer->sendSeq, buffer->sendSize));
+                buffer->sendPtr              = shared->payload + buffer->sendSeq % PATTERN_PERIOD;
+                buffer->sendSeq++;
+                buffer->prepared = 1;
+                stats.sendPackets++;
+            }
+            n = send(sockfd, (char*)&buffer->sendPrefix + buffer->sended, sizeof(PacketPrefix) - buffer->sended, 0);
+        }
+        else {
+            n = send(sockfd, buffer->sendPtr + buffer->sended - sizeof(PacketPrefix),
+                     sizeof(Header) + buffer->sendSize - buffer->sended, 0);
+        }
+        if (n >= 0) {
+            stats.sendSuccess++;
+            stats.sendBytes += n;
+            buffer->sended += n;
+            burst += n;
+            if (buffer->sended == sizeof(Header) + buffer->sendSize) {
+                buffer->sended   = 0;
+                buffer->prepared = 0;
+                if (shared->interval == 0 && burst >= SEND_BURST_MAX) {
+                    return 1; /* 水平触发，下一轮还会收到EPOLLOUT */
+                }
+            }
+        }
+        else { /* 遇到错误 */
+            if (errno != EWOULDBLOCK) {
+                stats.sendError++;
+                logError(-1, logfp, "PressureGenerator - client %d - send error", sockfd);
+                removeClient(sockfd);
+                return -1;
+            }
+            stats.sendEAGAIN++;
+            /* 开环模式：等待EPOLLOUT后继续发送，期间到期的报文随后补发 */
+            if (shared->interval > 0 && buffer->blocked == 0) {
+                buffer->blocked = 1;
+                modfd(epollfd, sockfd, 1, 1, 0);
+            }
+            return 1; /* 写到不能写了，退出 */
+        }
+    }
+}
+
+/* 突发模式：每个客户端独立地在开、关两个阶段间切换，时长服从给定均值的指数分布。
+ * 第一个阶段按稳态概率随机选择，各客户端的相位自然错开。
+ * 处于关阶段时返回1：开环模式把下一个报文推迟到关阶段结束（不计为晚发），
+ * 闭环模式暂停关注EPOLLOUT，由定时器在关阶段结束时恢复 */
+int Worker::burstPaused(const int& sockfd, ClientBuffer* buffer, uint64_t now) {
+    auto length = [this](int off) {
+        double mean = (double)(off ? shared->burstOff : shared->burstOn);
+        return (uint64_t)(-mean * std::log(1 - nextUniform(&rng))) + 1;
+    };
+    if (buffer->burstEnd == 0) {
+        buffer->burstOff = nextUniform(&rng) * (shared->burstOn + shared->burstOff) >= shared->burstOn;
+        buffer->burstEnd = now + length(buffer->burstOff);
+    }
+    while (buffer->burstEnd <= now) {
+        buffer->burstOff = !buffer->burstOff;
+        buffer->burstEnd += length(buffer->burstOff);
+    }
+    if (buffer->burstOff == 0) {
+        return 0;
+    }
+    if (shared->interval > 0) {
+        buffer->nextSend = std::max(buffer->nextSend, buffer->burstEnd);
+    }
+    else if (buffer->paused == 0) {
+        buffer->paused = 1;
+        modfd(epollfd, sockfd, 1, 0, 0);
+        timers.push(SendTimer(buffer->burstEnd, sockfd));
+    }
+    return 1;
+}
+
+/* 开环模式：把各客户端的第一个报文均匀错开在一个发送间隔内，避免同时发送 */
+void Worker::scheduleAll() {
+    uint64_t now = nowNanoseconds();
+    size_t   i   = 0;
+    for (auto& cli : clients) {
+        if (cli.second.state == 0) {
+            cli.second.buffer->nextSend = now + shared->interval * i / clients.size();
+            timers.push(SendTimer(cli.second.buffer->nextSend, cli.first));
+        }
+        ++i;
+    }
+    scheduled = 1;
+    logInfo(0, logfp, "PressureGenerator - worker %d - schedule %zd clients every %lu ns", index, timers.size(),
+            shared->interval);
+}
+
+/* 开环模式：发送所有已到计划时间的报文；闭环突发模式：恢复关阶段已结束的客户端 */
+void Worker::sendDue() {
+    uint64_t now = nowNanoseconds();
+    while (!timers.empty() && timers.top().first <= now) {
+        SendTimer timer = timers.top();
+        timers.pop();
+        auto it = clients.find(timer.second);
+        /* 闭环突发模式：关阶段结束，重新关注EPOLLOUT */
+        if (shared->interval == 0) {
+            if (it != clients.end() && it->second.state == 0 && it->second.buffer->paused
+                && it->second.buffer->burstEnd == timer.first) {
+                it->second.buffer->paused = 0;
+                modfd(epollfd, timer.second, 1, 1, 0);
+            }
+            continue;
+        }
+        /* 客户端已经离开、关闭了写或者在等待EPOLLOUT，定时器作废 */
+        if (it == clients.end() || it->second.state != 0 || it->second.buffer->blocked
+            || it->second.buffer->nextSend != timer.first) {
+            continue;
+        }
+        if (sendPackets(timer.second, it->second.buffer) == 0) {
+            timers.push(SendTimer(it->second.buffer->nextSend, timer.second));
+        }
+    }
+}
+
+/* 让timerfd在最早的计划时间唤醒epoll_wait */
+void Worker::armTimer() {
+    if (timers.empty() || timers.top().first == armedAt) {
+        return;
+    }
+    armedAt = timers.top().first;
+    struct itimerspec value;
+    bzero(&value, sizeof(value));
+    value.it_value.tv_sec  = armedAt / NANO_SEC;
+    value.it_value.tv_nsec = armedAt % NANO_SEC;
+    if (timerfd_settime(timerfd, TFD_TIMER_ABSTIME, &value, NULL) < 0) {
+        logError(-1, logfp, "PressureGenerator - worker %d - timerfd_settime error", index);
+    }
+}
+
+int Worker::removeClient(const int& sockfd) {
+    assert(clients.find(sockfd) != clients.end());
+    if (clients[sockfd].state == -1) {
+        uncnNum--;
+    }
+    else {
+        connNum--;
+    }
+    if (clients[sockfd].buffer != nullptr)
+        delete clients[sockfd].buffer;
+    clients.erase(sockfd);
+    if (close(sockfd) < 0) {
+        logError(-1, logfp, "PressureGenerator - client %d - close error", sockfd);
+    }
+    delfd(epollfd, sockfd);
+    logInfo(0, logfp, "PressureGenerator - client %d - client left (c:%zd u:%zd a:%zd)", sockfd, connNum, uncnNum,
+            connNum + uncnNum);
+    return 0;
+}
+
+/* 处理收到的n字节：依次解析报头、PacketTag和载荷，载荷与按序号生成的内容逐段比较 */
+void Worker::handleData(ClientBuffer* buffer, size_t n, const int& sockfd) {
+    while (true) {
+        size_t len  = std::min(n, buffer->unrecv);
+        char*  data = buffer->usrBuf + buffer->recved;
+        if (buffer->recvFlag == 0) {
+            memcpy((char*)&buffer->recvHeader + (sizeof(Header) - buffer->unrecv), data, len);
+        }
+        else if (buffer->recvFlag == 1) {
+            memcpy((char*)&buffer->recvTag + (sizeof(PacketTag) - buffer->unrecv), data, len);
+        }
+        else if (buffer->corrupt == 0 && len > 0) {
+            size_t      body   = buffer->recvSize - sizeof(PacketTag);
+            const char* expect = shared->payload + buffer->recvSeqNo % PATTERN_PERIOD + (body - buffer->unrecv);
+            buffer->corrupt    = memcmp(data, expect, len) != 0;
+        }
+        n              = n - len;
+        buffer->recved = buffer->recved + len;
+        buffer->unrecv = buffer->unrecv - len;
+        /* 只接收了一部分 */
+        if (buffer->unrecv > 0) {
+            break;
+        }
+        // 处理报头
+        if (buffer->recvFlag == 0) {
+            size_t msgLen = (size_t)handleHeader(&buffer->recvHeader, sockfd);
+            stats.recvPackets++; /* 报文数加1 */
+            buffer->recvSize = msgLen;
+            if (msgLen >= sizeof(PacketTag) && msgLen <= shared->maxPayload) {
+                buffer->recvFlag = 1;
+                buffer->unrecv   = sizeof(PacketTag);
+            }
+            else { /* 长度不可能由发生器发出，跳过整个载荷 */
+                buffer->corrupt  = 1;
+                buffer->recvFlag = 2;
+                buffer->unrecv   = msgLen;
+            }
+        }
+        // 处理PacketTag
+        else if (buffer->recvFlag == 1) {
+            checkTag(buffer);
+            buffer->recvFlag = 2;
+            buffer->unrecv   = buffer->recvSize - sizeof(PacketTag);
+        }
+        // 处理载荷
+        else {
+            if (buffer->corrupt) {
+                stats.recvCorrupted++;
+                buffer->corrupt = 0;
+            }
+            buffer->recvFlag = 0;
+            buffer->unrecv   = sizeof(Header);
+        }
+    }
+}
+
+/* 校验PacketTag并按序号统计丢失和乱序：序号跳过的报文计为丢失，小于期望序号的计为乱序或重复 */
+void Worker::checkTag(ClientBuffer* buffer) {
+    uint64_t seq = ntoh64(buffer->recvTag.seq);
+    if (ntoh64(buffer->recvTag.check) != tagChecksum(seq, buffer->recvSize)) {
+        buffer->corrupt = 1;
+        return;
+    }
+    buffer->recvSeqNo = seq;
+    if (seq < buffer->recvSeq) {
+        stats.recvReordered++;
+        return;
+    }
+    stats.recvLost += seq - buffer->recvSeq;
+    buffer->recvSeq = seq + 1;
+}
+
+uint16_t Worker::handleHeader(struct Header* header, const int& sockfd) {
+    uint16_t        msgLen = ntohs(header->length);
+    struct timespec timestamp;
+    timestamp.tv_sec  = ntoh64(header->sec);
+    timestamp.tv_nsec = ntoh64(header->nsec);
+    if (timestamp.tv_nsec >= NANO_SEC) {
+        perror("receive time wrong");
+    }
+    addDelay(&timestamp);
+    // logInfo(0, logfp, "PressureGenerator - client %d - recv header: <length: %hd, id: %d, time: %s>", sockfd, msgLen,
+    //         ntohl(header->id), strftTime(&timestamp).c_str());
+    return msgLen;
+}
+
+// void Worker::addDelay(struct timespec* timestamp) {
+//     struct timespec timeNow;
+//     clock_gettime(CLOCK_REALTIME, &timeNow);
+//     assert(timestamp->tv_nsec < NANO_SEC);
+//     if (timeNow.tv_sec < timestamp->tv_sec) {
+//         return;
+//     }
+//     else if (timeNow.tv_sec == timestamp->tv_sec) {
+//         if (timeNow.tv_nsec < timestamp->tv_nsec) {
+//             return;
+//         }
+//         else {
+//             stats.totalDelay.tv_nsec += (timeNow.tv_nsec - timestamp->tv_nsec);
+//             if (stats.totalDelay.tv_nsec > NANO_SEC) {
+//                 stats.totalDelay.tv_sec += stats.totalDelay.tv_nsec / NANO_SEC;
+//                 stats.totalDelay.tv_nsec %= NANO_SEC;
+//             }
+//         }
+//     }
+//     else {
+//         stats.totalDelay.tv_sec += (timeNow.tv_sec - timestamp->tv_sec);
+//         if (timeNow.tv_nsec < timestamp->tv_nsec) {
+//             if (stats.totalDelay.tv_nsec > (timestamp->tv_nsec - timeNow.tv_nsec)) {
+//                 stats.totalDelay.tv_nsec -= (timestamp->tv_nsec - timeNow.tv_nsec);
+//             }
+//             else {
+//                 stats.totalDelay.tv_nsec = NANO_SEC - ((timestamp->tv_nsec - timeNow.tv_nsec) - stats.totalDelay.tv_nsec);
+//                 stats.totalDelay.tv_sec--;
+//             }
+//         }
+//         else {
+//             stats.totalDelay.tv_nsec += (timeNow.tv_nsec - timestamp->tv_nsec);
+//             if (stats.totalDelay.tv_nsec > NANO_SEC) {
+//                 stats.totalDelay.tv_sec += stats.totalDelay.tv_nsec / NANO_SEC;
+//                 stats.totalDelay.tv_nsec %= NANO_SEC;
+//             }
+//         }
+//     }
+// }
+
+void Worker::addDelay(struct timespec* timestamp) {
+    struct timespec timeNow;
+    clock_gettime(CLOCK_REALTIME, &timeNow);
+    assert(timestamp->tv_nsec < NANO_SEC);
+    if (timestamp->tv_sec > timeNow.tv_sec
+        || (timestamp->tv_sec == timeNow.tv_sec && timestamp->tv_nsec > timeNow.tv_nsec)) {
+        return;
+    }
+    int64_t delay = (int64_t)(timeNow.tv_sec - timestamp->tv_sec) * NANO_SEC + (timeNow.tv_nsec - timestamp->tv_nsec);
+    stats.totalDelay += (double)delay / (NANO_SEC / 1000);
+    latency.record(delay);
+    if (shared->sampling) {
+        recentLatency.record(delay);
+    }
+}
@@ -0,0 +1,210 @@
+#pragma once
+
+#include "../common/common.hpp"
+#include "LatencyHistogram.hpp"
+#include "SizeDistribution.hpp"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <queue>
+#include <sys/timerfd.h>
+#include <thread>
+#include <vector>
+
+#define BUFFER_SIZE 12000
+#define WORKER_WAIT_MS 100 /* epoll_wait的超时时间，保证能及时看到退出标志 */
+#define CONN_PENDING_MIN 200 /* 未指定时每个Worker同时进行中的连接数上限的最小值 */
+#define PATTERN_PERIOD 251 /* 载荷内容的起点按报文序号在PATTERN_PERIOD个偏移间轮换，错位、重复的数据也能被发现 */
+#define SEND_BURST_MAX (64 * 1024) /* 闭环模式下一次EPOLLOUT最多发送的字节数，避免一轮事件循环被少数套接字占满 */
+
+/* 载荷开头的校验信息 */
+#pragma pack(1)
+typedef struct PacketTag {
+    uint64_t seq;   /* 发送方客户端的报文序号，从0开始 */
+    uint64_t check; /* 序号和载荷长度的校验和 */
+} PacketTag;
+
+/* 发送时报头和PacketTag一起发出 */
+typedef struct PacketPrefix {
+    Header    header;
+    PacketTag tag;
+} PacketPrefix;
+#pragma pack()
+
+typedef struct ClientBuffer {
+    char         usrBuf[BUFFER_SIZE];       /* 用户缓冲区（用来接收） */
+    size_t       unrecv   = sizeof(Header); /* 当前部分（报头、PacketTag或载荷）还需接收的数据量 */
+    size_t       recved   = 0;              /* 已经接收的数据量 */
+    int          recvFlag = 0;              /* 0: 正在接收头部，1：正在接收PacketTag，2：正在接收载荷 */
+    Header       recvHeader;                /* 正在接收报文的报头 */
+    size_t       recvSize = 0;              /* 正在接收报文的载荷大小 */
+    PacketTag    recvTag;                   /* 正在接收报文的PacketTag */
+    uint64_t     recvSeqNo = 0;             /* 正在接收报文的序号 */
+    uint64_t     recvSeq   = 0;             /* 期望收到的下一个序号 */
+    int          corrupt   = 0;             /* 正在接收的报文是否已发现损坏 */
+    PacketPrefix sendPrefix;                /* 正在发送的报文的报头和PacketTag */
+    size_t       sendSize = 0;              /* 正在发送报文的载荷大小 */
+    uint64_t     sendSeq  = 0;              /* 下一个发送报文的序号 */
+    char*        sendPtr  = nullptr;        /* 发送缓冲区指针 */
+    size_t       sended   = 0;              /* 已发送的数据 */
+    int          prepared = 0;              /* sendPrefix是否已经填好（可能一个字节都还没发出） */
+    uint64_t     nextSend = 0;              /* 开环模式：下一个报文的计划发送时间（纳秒） */
+    int          blocked  = 0;              /* 开环模式：发送缓冲区已满，正在等待EPOLLOUT */
+    uint64_t     burstEnd = 0;              /* 突发模式：当前开/关阶段的结束时间（纳秒），0表示还未开始 */
+    int          burstOff = 0;              /* 突发模式：是否处于不发送的关阶段 */
+    int          paused   = 0;              /* 闭环突发模式：关阶段中不关注EPOLLOUT，等定时器恢复 */
+} ClientBuffer;
+
+typedef struct ClientInfo {
+    int           connfd;                 /* 套接字 */
+    int           state        = -1;      /* -1: 未连接 0: 正常连接，1：关闭写的一端 */
+    ClientBuffer* buffer       = nullptr;
+    uint64_t      connectStart = 0;       /* 调用connect的时间（CLOCK_MONOTONIC，纳秒） */
+} ClientInfo;
+
+/* 统计数据，每个Worker线程各自一份，结束后汇总 */
+typedef struct Statistics {
+    double   totalDelay    = 0; /* 总延迟 */
+    uint64_t recvBytes     = 0; /* 接收到的数据数量 */
+    uint64_t recvPackets   = 0; /* 收到到报文数量 */
+    uint64_t recvSuccess   = 0; /* 接收到数据的次数 */
+    uint64_t recvEAGAIN    = 0; /* recv 返回EWOULDBLOCK的次数 */
+    uint64_t recvError     = 0; /* recv 返回其他错误的次数 */
+    uint64_t recvFINs      = 0; /* recv 返回0的次数 */
+    uint64_t recvLost      = 0; /* 序号跳过的报文数 */
+    uint64_t recvReordered = 0; /* 序号小于期望值（乱序或重复）的报文数 */
+    uint64_t recvCorrupted = 0; /* 报头长度、PacketTag或载荷内容不对的报文数 */
+    uint64_t sendBytes     = 0; /* 发送的数据量 */
+    uint64_t sendPackets   = 0; /* 发送的报文数量 */
+    uint64_t sendSuccess   = 0; /* 成功发送数据的次数 */
+    uint64_t sendEAGAIN    = 0; /* send 返回EWOULDBLOCK的次数 */
+    uint64_t sendError     = 0; /* send 返回其他错误的次数 */
+    uint64_t sendLate      = 0; /* 开环模式下比计划时间晚一个间隔以上才开始发送的报文数 */
+    uint64_t connectErrors = 0; /* socket、connect失败或连接未能建立的次数 */
+    uint64_t connectCapped = 0; /* 还有配额却因进行中的连接数达到上限而停止发起连接的次数 */
+} Statistics;
+
+/* 将src中的统计数据累加到dst */
+void addStatistics(Statistics* dst, const Statistics* src);
+
+/* 所有Worker共享的状态：只读的配置和少量跨线程的标志 */
+typedef struct SharedState {
+    struct sockaddr_in                    servaddr;    /* 服务器地址结构 */
+    char*                                 payload;     /* 初始化的数据包（只读） */
+    const SizeDistribution*               sizes;       /* 报文大小（包括报头）的分布 */
+    size_t                                maxPayload;  /* 最大的载荷大小，收到更长的报文视为损坏 */
+    uint64_t                              interval;    /* 开环模式下每个客户端的发送间隔（纳秒），0表示闭环 */
+    uint64_t                              burstOn;     /* 突发模式：开阶段的平均时长（纳秒），0表示一直发送 */
+    uint64_t                              burstOff;    /* 突发模式：关阶段的平均时长（纳秒） */
+    double                                connRate;    /* 每个Worker每秒发起的连接数，0表示不限速 */
+    int                                   connBurst;   /* 每个Worker每轮最多发起的连接数 */
+    size_t                                connPending; /* 每个Worker同时进行中的连接数上限 */
+    size_t                                cliCount;    /* 所有Worker要求的客户端总数 */
+    std::atomic<size_t>                   connected;   /* 已连接过的客户端数量 */
+    std::atomic<int>                      recordFlag;  /* 是否所有客户端都已连接、开始发送报文 */
+    std::atomic<int>                      stopFlag;    /* 某个Worker出错时通知所有Worker退出 */
+    std::atomic<int>                      running;     /* 尚未结束的Worker数量 */
+    int                                   sampling;    /* 是否输出时间序列 */
+    std::atomic<uint64_t>                 sampleEpoch; /* 主线程每个采样间隔加1，Worker看到变化后发布一次采样 */
+    const volatile int*                   exitFlag;    /* 捕获信号后的退出标志 */
+    std::chrono::steady_clock::time_point startTime;   /* 开始发送数据的时间 */
+
+    SharedState() : connected(0), recordFlag(0), stopFlag(0), running(0), sampling(0), sampleEpoch(0) {}
+} SharedState;
+
+/* 开环模式的发送定时器：<计划发送时间, 套接字> */
+typedef std::pair<uint64_t, int> SendTimer;
+typedef std::priority_queue<SendTimer, std::vector<SendTimer>, std::greater<SendTimer>> SendTimerQueue;
+
+/* 一个发生器线程：独立的epoll事件表、一部分会话的客户端、统计数据和延迟直方图 */
+class Worker {
+private:
+    int                                   index;             /* Worker编号 */
+    size_t                                cliCount;          /* 本Worker负责的客户端数 */
+    SharedState*                          shared;            /* 共享状态 */
+    FILE*                                 logfp = nullptr;   /* log文件指针 */
+    std::map<int, ClientInfo>             clients;           /* 客户端集合 */
+    std::vector<struct epoll_event>       events;            /* epoll_wait返回的事件 */
+    std::thread                           thread;            /* 运行事件循环的线程 */
+    int                                   epollfd  = -1;     /* epoll描述符 */
+    size_t                                connNum  = 0;      /* 已连接客户端数量 */
+    size_t                                uncnNum  = 0;      /* 未连接客户端数量 */
+    int                                   shutFlag = 0;      /* 是否已经把所有套接字写的一端关闭 */
+    Statistics                            stats;             /* 本线程的统计数据 */
+    LatencyHistogram                      latency;           /* 本线程的报文延迟分布（纳秒） */
+    std::chrono::steady_clock::time_point endTime;           /* 结束发送数据的时间 */
+    SendTimerQueue                        timers;            /* 开环模式：按计划时间排序的定时器 */
+    int                                   timerfd    = -1;   /* 开环模式：在最早的计划时间唤醒epoll_wait */
+    uint64_t                              armedAt    = 0;    /* timerfd当前设置的唤醒时间 */
+    int                                   scheduled  = 0;    /* 开环模式：是否已经为所有客户端安排了第一个报文 */
+    double                                connTokens = 1;    /* 限速连接的令牌数 */
+    uint64_t                              connRefill = 0;    /* 上次补充令牌的时间（CLOCK_MONOTONIC，纳秒） */
+    LatencyHistogram                      connectLatency;    /* connect到连接建立的用时分布（纳秒） */
+    uint64_t                              rng = 0;           /* 抽取报文大小和开/关时长的随机数状态 */
+    LatencyHistogram                      recentLatency;     /* 上次发布采样之后的报文延迟 */
+    uint64_t                              sampleEpoch = 0;   /* 最近一次发布采样时的采样序号 */
+    std::atomic<uint64_t>                 published;         /* 已发布的采样序号，线程结束后为UINT64_MAX */
+    std::mutex                            sampleMutex;       /* 保护下面的采样数据，主线程读取时加锁 */
+    Statistics                            sampleStats;       /* 发布采样时的累计统计 */
+    LatencyHistogram                      sampleLatency;     /* 主线程上次取走之后发布的报文延迟 */
+    size_t                                sampleConnNum = 0; /* 发布采样时的已连接客户端数 */
+    size_t                                sampleUncnNum = 0; /* 发布采样时的未连接客户端数 */
+
+    void     run();
+    int      addClients();
+    int      connectQuota();
+    int      waitTimeout();
+    void     addOneClient(int sockfd, int state);
+    void     onConnected();
+    void     shutdownAll();
+    int      handleEvents(const int& number);
+    int      removeClient(const int& sockfd);
+    int      sendPackets(const int& sockfd, ClientBuffer* buffer);
+    int      burstPaused(const int& sockfd, ClientBuffer* buffer, uint64_t now);
+    void     scheduleAll();
+    void     armTimer();
+    void     sendDue();
+    void     addDelay(struct timespec* timestamp);
+    void     handleData(ClientBuffer* buffer, size_t n, const int& sockfd);
+    void     checkTag(ClientBuffer* buffer);
+    void     publishSample();
+    uint16_t handleHeader(struct Header* header, const int& sockfd);
+
+public:
+    Worker(int index, size_t cliCount, SharedState* shared, FILE* logfp)
+        : index(index), cliCount(cliCount), shared(shared), logfp(logfp), published(0) {}
+
+    ~Worker();
+
+    /* 创建epoll事件表并启动线程 */
+    int start();
+
+    /* 等待线程结束 */
+    void join();
+
+    const Statistics& statistics() const {
+        return stats;
+    }
+
+    const LatencyHistogram& latencyHistogram() const {
+        return latency;
+    }
+
+    const LatencyHistogram& connectHistogram() const {
+        return connectLatency;
+    }
+
+    /* 是否已经发布了序号为epoch的采样（线程结束后总是返回true） */
+    bool hasSampled(uint64_t epoch) const {
+        return published.load(std::memory_order_acquire) >= epoch;
+    }
+
+    /* 取走最近发布的采样：累计统计累加到stats，延迟累加到latency */
+    void takeSample(Statistics* stats, size_t* connected, size_t* connecting, LatencyHistogram* latency);
+
+    std::chrono::steady_clock::time_point stopTime() const {
+        return endTime;
+    }
+};
@@ -1,14 +1,81 @@
 #include "PressureGenerator.hpp"
 
+/* 合并多次运行保存的延迟直方图并输出百分位 */
+static int mergeLatency(int count, char** files) {
+    LatencyHistogram latency;
+    for (int i = 0; i < count; ++i) {
+        if (latency.load(files[i]) < 0) {
+            printf("Failed to load latency histogram %s\n", files[i]);
+            return -1;
+        }
+    }
+    printf("count: %lu\n", latency.count());
+    printf("p50Delay: %lf\n", (double)latency.percentile(50) / 1000000);
+    printf("p90Delay: %lf\n", (double)latency.percentile(90) / 1000000);
+    printf("p99Delay: %lf\n", (double)latency.percentile(99) / 1000000);
+    printf("p999Delay: %lf\n", (double)latency.percentile(99.9) / 1000000);
+    printf("maxDelay: %lf\n\n", (double)latency.max() / 1000000);
+    latency.dump(stdout);
+    return 0;
+}
+
+static void usage() {
+    printf("usage: PressureGenerator [-t Threads] [-R Rate] [-c ConnectRate] [-B ConnectBurst] [-P ConnectPending] [-b On:Off] [-o SeriesFile] [-i Interval] <IP_Address> <Port> <Seession_Count> <Time> <Packet_Size>\n");
+    printf("       PressureGenerator -r <Latency_Histogram>...\n");
+    printf("Packet_Size: N | fixed:N | uniform:MIN:MAX | bimodal:SMALL:LARGE:P | zipf:MIN:MAX:S | file:PATH\n");
+}
+
 int main(int argc, char** argv) {
-    if (argc != 6) {
-        printf("usage: PressureGenerator <IP_Address> <Port> <Seession_Count> <Time> <Packet_Size>\n");
+    GeneratorConfig config;
+    int             mergeFlag = 0;
+    int             opt;
+    while ((opt = getopt(argc, argv, "t:R:c:B:P:b:o:i:r")) != -1) {
+        switch (opt) {
+        case 't':
+            config.threads = atoi(optarg);
+            break;
+        case 'R':
+            config.rate = atof(optarg);
+            break;
+        case 'c':
+            config.connRate = atof(optarg);
+            break;
+        case 'B':
+            config.connBurst = atoi(optarg);
+            break;
+        case 'P':
+            config.connPending = atoi(optarg);
+            break;
+        case 'b':
+            if (sscanf(optarg, "%lf:%lf", &config.burstOn, &config.burstOff) != 2) {
+                usage();
+                return 0;
+            }
+            break;
+        case 'o':
+            config.seriesFile = optarg;
+            break;
+        case 'i':
+            config.seriesInterval = atof(optarg);
+            break;
+        case 'r':
+            mergeFlag = 1;
+            break;
+        default:
+            usage();
+            return 0;
+        }
+    }
+    if (mergeFlag && argc - optind > 0) {
+        return mergeLatency(argc - optind, argv + optind) < 0 ? 1 : 0;
+    }
+    if (mergeFlag || argc - optind != 5) {
+        usage();
         return 0;
     }
-    int               sessionCount = atoi(argv[3]);
-    int               seconds      = atoi(argv[4]);
-    int               packetSize   = atoi(argv[5]);
-    PressureGenerator generator;
-    generator.start(argv[1], argv[2], sessionCount, seconds, packetSize, 1);
+    int               sessionCount = atoi(argv[optind + 2]);
+    int               seconds      = atoi(argv[optind + 3]);
+    PressureGenerator generator(config);
+    generator.start(argv[optind], argv[optind + 1], sessionCount, seconds, argv[optind + 4], 1);
     return 0;
-}
\ No newline at end of file
+}
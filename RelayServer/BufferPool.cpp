@@ -0,0 +1,58 @@
+#include "BufferPool.hpp"
+#include <algorithm>
+
+BufferPool::BufferPool() {
+    for (int tier = 0; tier < BUFFER_TIERS; ++tier) {
+        maxFree[tier] = BUFFER_POOL_MAX_FREE / tierSize(tier);
+    }
+}
+
+BufferPool::~BufferPool() {
+    for (int tier = 0; tier < BUFFER_TIERS; ++tier) {
+        for (char* buf : freeLists[tier]) {
+            free(buf);
+        }
+    }
+}
+
+int BufferPool::prealloc(size_t count) {
+    maxFree[0] = std::max(maxFree[0], count); /* 预分配的缓冲区总能留在池中 */
+    freeLists[0].reserve(count);
+    while (freeLists[0].size() < count) {
+        char* buf = (char*)malloc(tierSize(0));
+        if (buf == nullptr) {
+            return -1;
+        }
+        freeLists[0].push_back(buf);
+    }
+    return 0;
+}
+
+char* BufferPool::acquire(int tier) {
+    char* buf;
+    if (!freeLists[tier].empty()) {
+        hits++;
+        buf = freeLists[tier].back();
+        freeLists[tier].pop_back();
+    }
+    else {
+        misses++;
+        buf = (char*)malloc(tierSize(tier));
+        if (buf == nullptr) {
+            return nullptr;
+        }
+    }
+    inUse += tierSize(tier);
+    peak = std::max(peak, inUse);
+    return buf;
+}
+
+void BufferPool::release(char* buf, int tier) {
+    inUse -= tierSize(tier);
+    if (freeLists[tier].size() < maxFree[tier]) {
+        freeLists[tier].push_back(buf);
+    }
+    else {
+        free(buf);
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "../common/common.hpp"
+#include <vector>
+
+#define BUFFER_TIERS 3                  /* 缓冲区大小分级数 */
+#define BUFFER_MIN_SIZE 4096            /* 最小一级缓冲区的大小，逐级乘4：4K、16K、64K */
+#define BUFFER_POOL_MAX_FREE (16 << 20) /* 每一级空闲链表最多保留的字节数 */
+
+/* 分级缓冲区池：会话只在有数据待转发时从池中借用缓冲区，转发完毕后立即归还，
+ * 空闲会话不占用缓冲区。每一级的空闲链表有字节数上限，超过时直接释放。
+ * 只被所属的Reactor线程使用，不加锁 */
+class BufferPool {
+private:
+    std::vector<char*> freeLists[BUFFER_TIERS]; /* 每一级的空闲缓冲区 */
+    size_t             maxFree[BUFFER_TIERS];   /* 每一级空闲链表的长度上限 */
+    uint64_t           hits   = 0;              /* 从空闲链表取得缓冲区的次数 */
+    uint64_t           misses = 0;              /* 空闲链表为空、从堆分配的次数 */
+    size_t             inUse  = 0;              /* 借出的字节数 */
+    size_t             peak   = 0;              /* 借出字节数的峰值 */
+
+public:
+    BufferPool();
+
+    ~BufferPool();
+
+    BufferPool(const BufferPool&)            = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    static size_t tierSize(int tier) {
+        return (size_t)BUFFER_MIN_SIZE << (2 * tier);
+    }
+
+    /* 为最小一级预分配count个缓冲区，内存不足时返回-1 */
+    int prealloc(size_t count);
+
+    /* 借用第tier级的缓冲区，内存不足时返回nullptr */
+    char* acquire(int tier);
+
+    /* 归还第tier级的缓冲区 */
+    void release(char* buf, int tier);
+
+    uint64_t hitCount() const {
+        return hits;
+    }
+
+    uint64_t missCount() const {
+        return misses;
+    }
+
+    size_t inUseBytes() const {
+        return inUse;
+    }
+
+    size_t peakBytes() const {
+        return peak;
+    }
+};
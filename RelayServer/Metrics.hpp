@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#define HISTOGRAM_BUCKETS 24 /* 直方图的有限桶数，第i个桶的上界是2^i，另有一个+Inf桶 */
+
+/* 只由所属线程写、可被指标线程随时读的计数器。
+ * 写入用relaxed的读取加存储而不是原子加，转发路径上没有带lock前缀的指令 */
+class Counter {
+private:
+    std::atomic<uint64_t> value;
+
+public:
+    Counter() : value(0) {}
+
+    Counter(const Counter&)            = delete;
+    Counter& operator=(const Counter&) = delete;
+
+    Counter& operator=(uint64_t n) {
+        value.store(n, std::memory_order_relaxed);
+        return *this;
+    }
+
+    Counter& operator+=(uint64_t n) {
+        value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+        return *this;
+    }
+
+    Counter& operator++() {
+        return *this += 1;
+    }
+
+    void operator++(int) {
+        *this += 1;
+    }
+
+    uint64_t load() const {
+        return value.load(std::memory_order_relaxed);
+    }
+
+    operator uint64_t() const {
+        return load();
+    }
+};
+
+/* 以2的幂为桶边界的直方图，记录一次只需要三次relaxed写入 */
+class Histogram {
+private:
+    Counter buckets[HISTOGRAM_BUCKETS + 1]; /* 第i个桶统计(2^(i-1), 2^i]内的值，最后一个桶统计更大的值 */
+    Counter total;                          /* 所有值的和 */
+    Counter number;                         /* 值的个数 */
+
+public:
+    static uint64_t upperBound(int bucket) {
+        return (uint64_t)1 << bucket;
+    }
+
+    void observe(uint64_t v) {
+        int i = v <= 1 ? 0 : 64 - __builtin_clzll(v - 1);
+        buckets[i < HISTOGRAM_BUCKETS ? i : HISTOGRAM_BUCKETS]++;
+        total += v;
+        number++;
+    }
+
+    /* 将other累加到本直方图 */
+    void merge(const Histogram& other) {
+        for (int i = 0; i <= HISTOGRAM_BUCKETS; ++i) {
+            buckets[i] += other.buckets[i];
+        }
+        total += other.total;
+        number += other.number;
+    }
+
+    uint64_t bucket(int i) const {
+        return buckets[i];
+    }
+
+    uint64_t sum() const {
+        return total;
+    }
+
+    uint64_t count() const {
+        return number;
+    }
+};
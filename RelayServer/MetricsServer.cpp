@@ -0,0 +1,249 @@
+#include "MetricsServer.hpp"
+#include <poll.h>
+#include <sys/un.h>
+
+/* 一个计数器或仪表类指标与Statistics中字段的对应关系 */
+typedef struct ScalarMetric {
+    const char*          name;  /* 指标名 */
+    const char*          type;  /* counter或gauge */
+    const char*          help;  /* 说明 */
+    Counter Statistics::*field; /* Statistics中的字段 */
+} ScalarMetric;
+
+/* 一个直方图指标与Statistics中字段的对应关系 */
+typedef struct HistogramMetric {
+    const char*            name;  /* 指标名 */
+    const char*            help;  /* 说明 */
+    Histogram Statistics::*field; /* Statistics中的字段 */
+} HistogramMetric;
+
+static const ScalarMetric scalarMetrics[] = {
+    { "relay_recv_bytes_total", "counter", "Bytes received from clients.", &Statistics::recvBytes },
+    { "relay_recv_packets_total", "counter", "Packet headers parsed.", &Statistics::recvPackets },
+    { "relay_recv_calls_total", "counter", "Receive calls that returned data.", &Statistics::recvSuccess },
+    { "relay_recv_eagain_total", "counter", "Receive calls that returned EAGAIN.", &Statistics::recvEAGAIN },
+    { "relay_recv_errors_total", "counter", "Receive calls that failed.", &Statistics::recvError },
+    { "relay_recv_fins_total", "counter", "FINs received from clients.", &Statistics::recvFINs },
+    { "relay_recv_no_space_total", "counter", "Readable events with no buffer space.", &Statistics::recvNoSpace },
+    { "relay_send_bytes_total", "counter", "Bytes sent to clients.", &Statistics::sendBytes },
+    { "relay_send_calls_total", "counter", "Send calls that succeeded.", &Statistics::sendSuccess },
+    { "relay_send_eagain_total", "counter", "Send calls that returned EAGAIN.", &Statistics::sendEAGAIN },
+    { "relay_send_errors_total", "counter", "Send calls that failed.", &Statistics::sendError },
+    { "relay_send_no_data_total", "counter", "Writable events with nothing to send.", &Statistics::sendNoData },
+    { "relay_send_cut_through_total", "counter", "Sends issued right after a receive.", &Statistics::sendCutThrough },
+    { "relay_pool_hits_total", "counter", "Allocations served from a pool free list.", &Statistics::poolHits },
+    { "relay_pool_misses_total", "counter", "Allocations that fell back to the heap.", &Statistics::poolMisses },
+    { "relay_alloc_failures_total", "counter", "Heap allocations that failed.", &Statistics::allocFailures },
+    { "relay_connections", "gauge", "Connected clients.", &Statistics::connections },
+    { "relay_sessions", "gauge", "Sessions with both ends connected.", &Statistics::sessions },
+    { "relay_buffered_bytes", "gauge", "Bytes held in receive buffers, pipes and send queues.",
+      &Statistics::bufferedBytes },
+    { "relay_buffer_peak_bytes", "gauge", "Peak bytes of receive buffers lent out by the reactor (use max, not sum).",
+      &Statistics::bufferPeak },
+    { "relay_offline_bytes_total", "counter", "Packet bytes written to the offline store.", &Statistics::offlineBytes },
+    { "relay_replay_bytes_total", "counter", "Bytes replayed from the offline store.", &Statistics::replayBytes },
+    { "relay_offline_stored_bytes", "gauge", "Bytes in the offline store not yet replayed.",
+      &Statistics::offlineStored },
+    { "relay_offline_memory_bytes", "gauge", "Bytes of offline messages held in memory.", &Statistics::offlineMemory },
+    { "relay_offline_spilled_bytes_total", "counter", "Offline bytes moved from memory to disk.",
+      &Statistics::offlineSpilled },
+    { "relay_offline_dropped_bytes_total", "counter", "Offline bytes dropped over the memory budget without a disk.",
+      &Statistics::offlineDropped },
+    { "relay_room_frames_total", "counter", "Frames received and fanned out in room mode.", &Statistics::roomFrames },
+    { "relay_room_dropped_total", "counter", "Frame deliveries skipped for members over the lag limit.",
+      &Statistics::roomDropped },
+    { "relay_room_frame_bytes", "gauge", "Bytes of shared frames held in room mode.", &Statistics::roomBytes },
+    { "relay_backpressure_watermark_total", "counter", "Times a sender was paused at the high watermark.",
+      &Statistics::pauseWatermark },
+    { "relay_backpressure_budget_total", "counter", "Times a heavy sender was paused over the memory budget.",
+      &Statistics::pauseBudget },
+};
+
+static const HistogramMetric histogramMetrics[] = {
+    { "relay_recv_size_bytes", "Bytes returned by one receive.", &Statistics::recvSize },
+    { "relay_events_per_wait", "Events returned by one epoll_wait or io_uring_enter.", &Statistics::eventsPerWait },
+};
+
+/* 按printf格式追加到out */
+static void appendf(std::string& out, const char* fmt, ...) {
+    char    buf[256];
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+    va_end(ap);
+    out.append(buf, std::min((size_t)std::max(n, 0), sizeof(buf) - 1));
+}
+
+MetricsServer::~MetricsServer() {
+    stop();
+}
+
+int MetricsServer::start(const char* ip, const char* addr, FILE* logfp) {
+    this->logfp = logfp;
+    if (strchr(addr, '/') != nullptr) {
+        struct sockaddr_un unaddr;
+        bzero(&unaddr, sizeof(unaddr));
+        unaddr.sun_family = AF_UNIX;
+        if (strlen(addr) >= sizeof(unaddr.sun_path)) {
+            return logInfo(-1, logfp, "RelayServer - metrics - unix socket path too long");
+        }
+        strcpy(unaddr.sun_path, addr);
+        if ((listenfd = createSocket(AF_UNIX, SOCK_STREAM, 0, logfp)) < 0) {
+            return -1;
+        }
+        unlink(addr);
+        if (toBind(listenfd, (struct sockaddr*)&unaddr, sizeof(unaddr), logfp) < 0) {
+            close(listenfd);
+            listenfd = -1;
+            return -1;
+        }
+        unixPath = addr;
+    }
+    else {
+        struct sockaddr_in servaddr;
+        bzero(&servaddr, sizeof(servaddr));
+        servaddr.sin_family = AF_INET;
+        if (inetPton(AF_INET, ip, &servaddr.sin_addr, logfp) < 0 || setPort(addr, &servaddr.sin_port, logfp) < 0) {
+            return -1;
+        }
+        if ((listenfd = createSocket(AF_INET, SOCK_STREAM, 0, logfp)) < 0) {
+            return -1;
+        }
+        int reuse = 1;
+        setsockopt(listenfd, SOL_SOCKET, SO_REUSEADDR, (const void*)&reuse, sizeof(int));
+        if (toBind(listenfd, (struct sockaddr*)&servaddr, sizeof(servaddr), logfp) < 0) {
+            close(listenfd);
+            listenfd = -1;
+            return -1;
+        }
+    }
+    if (toListen(listenfd, METRICS_BACKLOG, logfp) < 0 || pipe(stopfd) < 0) {
+        close(listenfd);
+        listenfd = -1;
+        return logError(-1, logfp, "RelayServer - metrics - failed to start");
+    }
+    logInfo(0, logfp, "RelayServer - metrics - serve metrics on %s", addr);
+    thread = std::thread(&MetricsServer::run, this);
+    return 0;
+}
+
+void MetricsServer::stop() {
+    if (!thread.joinable()) {
+        return;
+    }
+    char c = 0;
+    if (write(stopfd[1], &c, 1) < 0) {
+        logError(-1, logfp, "RelayServer - metrics - write stop pipe error");
+    }
+    thread.join();
+    close(listenfd);
+    close(stopfd[0]);
+    close(stopfd[1]);
+    listenfd  = -1;
+    stopfd[0] = stopfd[1] = -1;
+    if (!unixPath.empty()) {
+        unlink(unixPath.c_str());
+    }
+}
+
+void MetricsServer::run() {
+    /* 指标线程屏蔽SIGINT，由主线程处理 */
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    pthread_sigmask(SIG_BLOCK, &mask, NULL);
+    struct pollfd fds[2];
+    fds[0].fd     = listenfd;
+    fds[0].events = POLLIN;
+    fds[1].fd     = stopfd[0];
+    fds[1].events = POLLIN;
+    while (true) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            logError(-1, logfp, "RelayServer - metrics - poll error");
+            break;
+        }
+        if (fds[1].revents & POLLIN) {
+            break;
+        }
+        if (fds[0].revents & POLLIN) {
+            int connfd = accept(listenfd, NULL, NULL);
+            if (connfd >= 0) {
+                serve(connfd);
+                close(connfd);
+            }
+        }
+    }
+}
+
+/* 读取一个HTTP请求并回复，只提供GET /metrics */
+void MetricsServer::serve(int connfd) {
+    struct timeval timeout = { METRICS_TIMEOUT_SEC, 0 };
+    setsockopt(connfd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    setsockopt(connfd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+    char   request[METRICS_REQUEST_MAX + 1];
+    size_t len = 0;
+    while (len < METRICS_REQUEST_MAX) {
+        ssize_t n = recv(connfd, request + len, METRICS_REQUEST_MAX - len, 0);
+        if (n <= 0) {
+            return;
+        }
+        len += n;
+        request[len] = '\0';
+        if (strstr(request, "\r\n\r\n") != nullptr || strstr(request, "\n\n") != nullptr) {
+            break;
+        }
+    }
+    request[len] = '\0';
+    std::string body, response;
+    if (strncmp(request, "GET /metrics ", 13) == 0 || strncmp(request, "GET / ", 6) == 0) {
+        body = render();
+        appendf(response, "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %zu\r\n\r\n",
+                body.size());
+    }
+    else {
+        body = "not found\n";
+        appendf(response, "HTTP/1.0 404 Not Found\r\nContent-Type: text/plain\r\nContent-Length: %zu\r\n\r\n",
+                body.size());
+    }
+    response += body;
+    size_t sent = 0;
+    while (sent < response.size()) {
+        ssize_t n = send(connfd, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) {
+            return;
+        }
+        sent += n;
+    }
+}
+
+/* 按Prometheus文本格式输出所有指标，每个Reactor一条时间序列 */
+std::string MetricsServer::render() const {
+    std::string out;
+    for (const ScalarMetric& metric : scalarMetrics) {
+        appendf(out, "# HELP %s %s\n# TYPE %s %s\n", metric.name, metric.help, metric.name, metric.type);
+        for (size_t i = 0; i < reactors->size(); ++i) {
+            const Statistics& stats = (*reactors)[i]->statistics();
+            appendf(out, "%s{reactor=\"%zu\"} %lu\n", metric.name, i, (stats.*metric.field).load());
+        }
+    }
+    for (const HistogramMetric& metric : histogramMetrics) {
+        appendf(out, "# HELP %s %s\n# TYPE %s histogram\n", metric.name, metric.help, metric.name);
+        for (size_t i = 0; i < reactors->size(); ++i) {
+            const Histogram& hist       = (*reactors)[i]->statistics().*metric.field;
+            uint64_t         cumulative = 0;
+            for (int b = 0; b < HISTOGRAM_BUCKETS; ++b) {
+                cumulative += hist.bucket(b);
+                appendf(out, "%s_bucket{reactor=\"%zu\",le=\"%lu\"} %lu\n", metric.name, i, Histogram::upperBound(b),
+                        cumulative);
+            }
+            cumulative += hist.bucket(HISTOGRAM_BUCKETS);
+            appendf(out, "%s_bucket{reactor=\"%zu\",le=\"+Inf\"} %lu\n", metric.name, i, cumulative);
+            appendf(out, "%s_sum{reactor=\"%zu\"} %lu\n", metric.name, i, hist.sum());
+            appendf(out, "%s_count{reactor=\"%zu\"} %lu\n", metric.name, i, cumulative);
+        }
+    }
+    return out;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "Reactor.hpp"
+#include <string>
+#include <thread>
+#include <vector>
+
+#define METRICS_BACKLOG 16       /* 指标端口的listen队列大小 */
+#define METRICS_REQUEST_MAX 4096 /* 读取HTTP请求的最大字节数 */
+#define METRICS_TIMEOUT_SEC 1    /* 读写一个指标请求的超时时间（秒） */
+
+/* 指标线程：在独立的端口或Unix套接字上以Prometheus文本格式提供各Reactor的统计数据。
+ * 每次请求时直接读取各Reactor的计数器，转发路径上不加锁也不做任何额外的同步 */
+class MetricsServer {
+private:
+    const std::vector<Reactor*>* reactors;               /* 被观测的Reactor */
+    FILE*                        logfp     = nullptr;    /* log文件指针 */
+    int                          listenfd  = -1;         /* 指标监听套接字 */
+    int                          stopfd[2] = { -1, -1 }; /* 通知指标线程退出的管道 */
+    std::string                  unixPath;               /* Unix套接字路径，退出时删除 */
+    std::thread                  thread;                 /* 指标线程 */
+
+    void        run();
+    void        serve(int connfd);
+    std::string render() const;
+
+public:
+    explicit MetricsServer(const std::vector<Reactor*>* reactors) : reactors(reactors) {}
+
+    ~MetricsServer();
+
+    /* 以ip和端口号监听，addr中含有'/'时视为Unix套接字路径 */
+    int start(const char* ip, const char* addr, FILE* logfp);
+
+    /* 停止监听并等待指标线程结束，未启动时直接返回 */
+    void stop();
+};
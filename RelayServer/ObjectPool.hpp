@@ -0,0 +1,90 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <vector>
+
+/* 对象池：启动时一次性预分配一块连续的slab，之后的分配和释放都只操作空闲链表。
+ * slab用尽后退回堆分配，堆上分配的对象在空闲链表未超过maxFree时也会留在池中复用，
+ * 超过时直接释放，因此连接数回落后池中多余的内存是有上限的。
+ * 只被所属的Reactor线程使用，不加锁 */
+template <typename T>
+class ObjectPool {
+private:
+    T*              slab     = nullptr; /* 预分配的对象 */
+    size_t          slabSize = 0;       /* 预分配的对象个数 */
+    std::vector<T*> freeList;           /* 可复用的对象 */
+    size_t          maxFree  = 0;       /* 空闲链表中堆对象的上限 */
+    size_t          spare    = 0;       /* 空闲链表中堆对象的个数 */
+    uint64_t        hits     = 0;       /* 从空闲链表取得对象的次数 */
+    uint64_t        misses   = 0;       /* 空闲链表为空、从堆分配的次数 */
+
+    int fromSlab(const T* obj) const {
+        return obj >= slab && obj < slab + slabSize;
+    }
+
+public:
+    explicit ObjectPool(size_t maxFree) : maxFree(maxFree) {}
+
+    ObjectPool(const ObjectPool&)            = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+
+    ~ObjectPool() {
+        for (T* obj : freeList) {
+            if (!fromSlab(obj)) {
+                delete obj;
+            }
+        }
+        delete[] slab;
+    }
+
+    /* 预分配count个对象，只能调用一次 */
+    void prealloc(size_t count) {
+        if (slab != nullptr || count == 0) {
+            return;
+        }
+        slab     = new T[count];
+        slabSize = count;
+        freeList.reserve(count + maxFree);
+        for (size_t i = count; i > 0; --i) {
+            freeList.push_back(slab + i - 1);
+        }
+    }
+
+    /* 取得一个对象，对象的内容是上一次使用后留下的，由调用者重新初始化 */
+    T* acquire() {
+        if (!freeList.empty()) {
+            hits++;
+            T* obj = freeList.back();
+            freeList.pop_back();
+            if (!fromSlab(obj)) {
+                spare--;
+            }
+            return obj;
+        }
+        misses++;
+        return new T;
+    }
+
+    /* 归还对象：slab中的对象总是回到空闲链表，堆对象超过上限时释放 */
+    void release(T* obj) {
+        if (fromSlab(obj)) {
+            freeList.push_back(obj);
+        }
+        else if (spare < maxFree) {
+            freeList.push_back(obj);
+            spare++;
+        }
+        else {
+            delete obj;
+        }
+    }
+
+    uint64_t hitCount() const {
+        return hits;
+    }
+
+    uint64_t missCount() const {
+        return misses;
+    }
+};
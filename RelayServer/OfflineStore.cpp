@@ -0,0 +1,669 @@
+#include "OfflineStore.hpp"
+#include <algorithm>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+OfflineStore::~OfflineStore() {
+    close();
+}
+
+std::atomic<size_t> OfflineStore::memoryUsed(0);
+std::mutex          OfflineStore::storesLock;
+OfflineStore*       OfflineStore::stores = nullptr;
+
+int OfflineStore::open(const char* dir, size_t budget, uint64_t maxAge, FILE* logfp) {
+    this->logfp  = logfp;
+    this->budget = budget;
+    this->maxAge = maxAge;
+    active       = 1;
+    {
+        std::lock_guard<std::mutex> lock(storesLock);
+        nextStore = stores;
+        stores    = this;
+    }
+    if (dir == nullptr) {
+        return 0;
+    }
+    if (mkdir(dir, 0755) < 0 && errno != EEXIST) {
+        return logError(-1, logfp, "RelayServer - offline store - fail to create directory %s", dir);
+    }
+    wakefd   = eventfd(0, EFD_NONBLOCK);
+    notifyfd = eventfd(0, EFD_NONBLOCK);
+    if (wakefd < 0 || notifyfd < 0) {
+        return logError(-1, logfp, "RelayServer - offline store - eventfd error");
+    }
+    this->dir = dir;
+    thread    = std::thread(&OfflineStore::ioLoop, this);
+    return 0;
+}
+
+void OfflineStore::close() {
+    if (!active) {
+        return;
+    }
+    for (auto& entry : spools) {
+        while (!entry.second.blocks.empty()) {
+            freeBlock(&entry.second);
+        }
+        while (!entry.second.segments.empty()) {
+            dropSegment(entry.first, &entry.second);
+        }
+    }
+    spools.clear();
+    dirtyIDs.clear();
+    ages.clear();
+    oldest.store(UINT64_MAX, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(storesLock);
+        OfflineStore** link = &stores;
+        while (*link != this) {
+            link = &(*link)->nextStore;
+        }
+        *link = nextStore;
+    }
+    active = 0;
+    if (!thread.joinable()) {
+        return;
+    }
+    IoRequest stop;
+    stop.op = IO_STOP;
+    submit(stop);
+    /* I/O线程可能因完成队列已满而在等待，一边取走完成的请求一边提交剩余的请求 */
+    std::vector<uint32_t> ready;
+    while (true) {
+        wake();
+        complete(&ready);
+        if (backlog.empty()) {
+            break;
+        }
+        usleep(1000);
+    }
+    thread.join();
+    complete(&ready);
+    ::close(wakefd);
+    ::close(notifyfd);
+    wakefd = notifyfd = -1;
+    dir.clear();
+}
+
+std::string OfflineStore::segmentName(uint32_t cliID, uint64_t seq) const {
+    char name[NAME_MAX];
+    snprintf(name, sizeof(name), "/%u.%lu.seg", cliID, seq);
+    return dir + name;
+}
+
+/* 放入请求队列，队列已满或已有积压时先放入backlog，保持请求的顺序 */
+void OfflineStore::submit(const IoRequest& request) {
+    if (!backlog.empty() || !requests.push(request)) {
+        backlog.push_back(request);
+    }
+    else {
+        submitted++;
+    }
+}
+
+/* 尽量把积压的请求放入队列，有新请求时唤醒I/O线程 */
+void OfflineStore::wake() {
+    while (!backlog.empty() && requests.push(backlog.front())) {
+        backlog.pop_front();
+        submitted++;
+    }
+    if (submitted > 0) {
+        uint64_t one = 1;
+        if (write(wakefd, &one, sizeof(one)) < 0) {
+            logError(-1, logfp, "RelayServer - offline store - wake error");
+        }
+        submitted = 0;
+    }
+}
+
+void OfflineStore::append(uint32_t cliID, const void* buf, size_t len) {
+    Spool* spool = &spools[cliID];
+    spool->staging.insert(spool->staging.end(), (const char*)buf, (const char*)buf + len);
+}
+
+void OfflineStore::append(uint32_t cliID, const RingBuffer* ring, uint64_t pos, size_t len) {
+    struct iovec iov[2];
+    int          cnt = ring->regions(pos, len, iov);
+    for (int i = 0; i < cnt; ++i) {
+        append(cliID, iov[i].iov_base, iov[i].iov_len);
+    }
+}
+
+void OfflineStore::commit(uint32_t cliID) {
+    Spool* spool = &spools[cliID];
+    stored += spool->staging.size() - spool->committed;
+    spool->committed = spool->staging.size();
+    spool->staged++;
+    if (spool->committed >= OFFLINE_BLOCK_SIZE) {
+        stage(cliID, spool, nowNs());
+    }
+    else if (!spool->dirty) {
+        spool->dirty = 1;
+        dirtyIDs.push_back(cliID);
+    }
+}
+
+void OfflineStore::rollback(uint32_t cliID) {
+    auto it = spools.find(cliID);
+    if (it == spools.end()) {
+        return;
+    }
+    Spool* spool = &it->second;
+    spool->staging.resize(spool->committed);
+    if (spool->segments.empty() && spool->blocks.empty() && spool->staging.empty() && !spool->dirty) {
+        spools.erase(it);
+    }
+}
+
+void OfflineStore::flush() {
+    if (!active) {
+        return;
+    }
+    uint64_t now = nowNs();
+    for (uint32_t cliID : dirtyIDs) {
+        auto it = spools.find(cliID);
+        if (it == spools.end()) {
+            continue;
+        }
+        it->second.dirty = 0;
+        stage(cliID, &it->second, now);
+    }
+    dirtyIDs.clear();
+    /* 停留过久的内存块写入磁盘；超出内存预算时，只有本实例的块是所有Reactor中最旧的才写入磁盘，
+     * 否则留给持有更旧的块的Reactor处理（它会因timeout定期醒来），预算总是从全局最旧的块开始释放。
+     * 不写磁盘时只有超出预算才丢弃 */
+    pruneAges();
+    uint64_t others = memoryUsed.load(std::memory_order_relaxed) > budget ? othersOldest() : UINT64_MAX;
+    while (!ages.empty()) {
+        bool over = memoryUsed.load(std::memory_order_relaxed) > budget && ages.front().born <= others;
+        if (!over && (dir.empty() || ages.front().born + maxAge > now)) {
+            break;
+        }
+        BlockAge age = ages.front();
+        ages.pop_front();
+        spill(age.cliID, &spools[age.cliID]);
+        pruneAges();
+    }
+    if (thread.joinable()) {
+        wake();
+    }
+}
+
+/* 丢掉ages前部已回放或已写入磁盘的块（块序号不再匹配），并发布最旧的块的创建时间 */
+void OfflineStore::pruneAges() {
+    while (!ages.empty()) {
+        auto it = spools.find(ages.front().cliID);
+        if (it != spools.end() && !it->second.blocks.empty() && it->second.blocks.front().seq == ages.front().seq) {
+            break;
+        }
+        ages.pop_front();
+    }
+    oldest.store(ages.empty() ? UINT64_MAX : ages.front().born, std::memory_order_relaxed);
+}
+
+/* 其他实例中最旧的内存块的创建时间 */
+uint64_t OfflineStore::othersOldest() const {
+    std::lock_guard<std::mutex> lock(storesLock);
+    uint64_t                    result = UINT64_MAX;
+    for (const OfflineStore* store = stores; store != nullptr; store = store->nextStore) {
+        if (store != this) {
+            result = std::min(result, store->oldest.load(std::memory_order_relaxed));
+        }
+    }
+    return result;
+}
+
+int OfflineStore::timeout() const {
+    if (ages.empty()) {
+        return -1;
+    }
+    if (dir.empty()) {
+        return OFFLINE_POLL_MS;
+    }
+    uint64_t due = ages.front().born + maxAge;
+    uint64_t now = nowNs();
+    return due <= now ? 0 : (int)std::min<uint64_t>((due - now + 999999) / 1000000, OFFLINE_POLL_MS);
+}
+
+/* 把暂存的完整报文放入内存块：最后一块还有空间时追加，否则新建一块；未完成的报文留在暂存区 */
+void OfflineStore::stage(uint32_t cliID, Spool* spool, uint64_t now) {
+    size_t len = spool->committed;
+    if (len == 0) {
+        return;
+    }
+    if (!spool->blocks.empty() && spool->blocks.back().data->size() + len <= OFFLINE_BLOCK_SIZE) {
+        Block* block = &spool->blocks.back();
+        block->data->insert(block->data->end(), spool->staging.begin(), spool->staging.begin() + len);
+        block->frames += spool->staged;
+        spool->staging.erase(spool->staging.begin(), spool->staging.begin() + len);
+    }
+    else {
+        Block block;
+        block.data   = new std::vector<char>();
+        block.frames = spool->staged;
+        block.seq    = nextBlock++;
+        if (spool->staging.size() == len) {
+            block.data->swap(spool->staging); /* 整个暂存区变成内存块，离线接收方可能很多，不保留暂存区 */
+        }
+        else {
+            block.data->assign(spool->staging.begin(), spool->staging.begin() + len);
+            spool->staging.erase(spool->staging.begin(), spool->staging.begin() + len);
+        }
+        spool->blocks.push_back(block);
+        BlockAge age;
+        age.born  = now;
+        age.cliID = cliID;
+        age.seq   = block.seq;
+        ages.push_back(age);
+    }
+    memory += len;
+    memoryUsed.fetch_add(len, std::memory_order_relaxed);
+    spool->committed = 0;
+    spool->staged    = 0;
+}
+
+/* 把第一个内存块中尚未回放的部分交给I/O线程写入磁盘，不写磁盘时丢弃 */
+void OfflineStore::spill(uint32_t cliID, Spool* spool) {
+    Block  block = spool->blocks.front();
+    size_t sent  = spool->segments.empty() ? spool->readOff : 0;
+    size_t size  = block.data->size();
+    spool->blocks.pop_front();
+    memory -= size;
+    memoryUsed.fetch_sub(size, std::memory_order_relaxed);
+    if (sent > 0) {
+        block.data->erase(block.data->begin(), block.data->begin() + sent);
+        spool->readOff = 0;
+    }
+    if (dir.empty()) {
+        logError(0, logfp, "RelayServer - offline store - client %u - %zu bytes dropped, over memory budget", cliID,
+                 block.data->size());
+        stored -= block.data->size();
+        dropped += block.data->size();
+        delete block.data;
+    }
+    else {
+        spilled += block.data->size();
+        writeSegment(cliID, spool, block.data, block.frames);
+    }
+}
+
+/* 释放已回放的第一个内存块 */
+void OfflineStore::freeBlock(Spool* spool) {
+    Block  block = spool->blocks.front();
+    size_t size  = block.data->size();
+    stored -= size - (spool->segments.empty() ? spool->readOff : 0);
+    memory -= size;
+    memoryUsed.fetch_sub(size, std::memory_order_relaxed);
+    if (spool->segments.empty()) {
+        spool->readOff = 0;
+    }
+    delete block.data;
+    spool->blocks.pop_front();
+}
+
+/* 把buffer交给I/O线程追加到最后一个段，段已封闭或写满时换新段 */
+void OfflineStore::writeSegment(uint32_t cliID, Spool* spool, std::vector<char>* buffer, uint32_t frames) {
+    if (!spool->open || spool->segments.back().size + buffer->size() > OFFLINE_SEGMENT_SIZE) {
+        Segment segment;
+        segment.seq = spool->nextSeq++;
+        spool->segments.push_back(segment);
+        spool->open = 1;
+    }
+    Segment* segment = &spool->segments.back();
+    segment->size += buffer->size();
+    segment->frames += frames;
+    IoRequest request;
+    request.op     = IO_WRITE;
+    request.cliID  = cliID;
+    request.seq    = segment->seq;
+    request.buffer = buffer;
+    submit(request);
+}
+
+/* 删除第一个段：由I/O线程解除映射并删除文件 */
+void OfflineStore::dropSegment(uint32_t cliID, Spool* spool) {
+    Segment*  segment = &spool->segments.front();
+    IoRequest request;
+    request.op    = IO_DROP;
+    request.cliID = cliID;
+    request.seq   = segment->seq;
+    request.map   = segment->map;
+    request.len   = segment->size;
+    submit(request);
+    stored -= segment->size - spool->readOff;
+    spool->readOff = 0;
+    spool->segments.pop_front();
+    if (spool->segments.empty()) {
+        spool->open = 0;
+    }
+}
+
+void OfflineStore::prefetch(uint32_t cliID, Segment* segment) {
+    IoRequest request;
+    request.op           = IO_PREFETCH;
+    request.cliID        = cliID;
+    request.seq          = segment->seq;
+    request.len          = segment->size;
+    segment->prefetching = 1;
+    submit(request);
+}
+
+void OfflineStore::complete(std::vector<uint32_t>* ready) {
+    uint64_t count;
+    if (read(notifyfd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+        logError(-1, logfp, "RelayServer - offline store - read notify error");
+    }
+    IoRequest request;
+    while (completions.pop(&request)) {
+        auto     it      = spools.find(request.cliID);
+        Spool*   spool   = it == spools.end() ? nullptr : &it->second;
+        Segment* segment = nullptr;
+        for (size_t i = 0; spool != nullptr && i < spool->segments.size(); ++i) {
+            if (spool->segments[i].seq == request.seq) {
+                segment = &spool->segments[i];
+                break;
+            }
+        }
+        if (request.op == IO_WRITE) {
+            size_t len = request.buffer->size();
+            delete request.buffer;
+            if (segment == nullptr) {
+                continue;
+            }
+            if (request.result < 0) {
+                logError(0, logfp, "RelayServer - offline store - client %u - %zu bytes lost", request.cliID, len);
+                segment->size -= len; /* 写入失败的报文被丢弃，段文件已截断到写入前的长度 */
+                stored -= len;
+            }
+            else {
+                segment->written += len;
+            }
+            /* 回放在等待这个段写完，接着预读，不必先通知事件循环 */
+            if (spool->waiting && segment == &spool->segments.front() && segment->written == segment->size
+                && segment->size > 0 && !segment->prefetching) {
+                prefetch(request.cliID, segment);
+                continue;
+            }
+        }
+        else if (request.op == IO_PREFETCH) {
+            if (segment == nullptr) {
+                if (request.map != nullptr) {
+                    munmap(request.map, request.len);
+                }
+                continue;
+            }
+            segment->prefetching = 0;
+            if (request.result < 0) {
+                /* 无法读取的段整个丢弃 */
+                logError(0, logfp, "RelayServer - offline store - client %u - segment %lu lost", request.cliID,
+                         request.seq);
+                stored -= segment->size - (segment == &spool->segments.front() ? spool->readOff : 0);
+                spool->readOff = segment == &spool->segments.front() ? 0 : spool->readOff;
+                segment->size = segment->written = 0;
+            }
+            else {
+                segment->map = request.map;
+            }
+        }
+        if (spool != nullptr && spool->waiting) {
+            spool->waiting = 0;
+            ready->push_back(request.cliID);
+        }
+    }
+}
+
+bool OfflineStore::pending(uint32_t cliID) const {
+    auto it = spools.find(cliID);
+    return it != spools.end()
+           && (!it->second.segments.empty() || !it->second.blocks.empty() || it->second.committed > 0);
+}
+
+int OfflineStore::replay(uint32_t cliID, int connfd, size_t* sent) {
+    *sent   = 0;
+    auto it = spools.find(cliID);
+    if (it == spools.end()) {
+        return 0;
+    }
+    Spool* spool = &it->second;
+    stage(cliID, spool, nowNs()); /* 刚暂存的报文直接从内存回放 */
+    spool->open = 0; /* 封闭正在追加的段，之后到达的报文写入新段，段的长度不再变化 */
+    while (!spool->segments.empty()) {
+        Segment* segment = &spool->segments.front();
+        if (segment->size == 0) {
+            dropSegment(cliID, spool);
+            continue;
+        }
+        if (segment->map == nullptr) {
+            if (segment->written == segment->size && !segment->prefetching) {
+                prefetch(cliID, segment);
+            }
+            spool->waiting = 1;
+            return 2;
+        }
+        /* 发送当前段的同时预读下一段 */
+        if (spool->segments.size() > 1) {
+            Segment* next = &spool->segments[1];
+            if (next->map == nullptr && !next->prefetching && next->size > 0 && next->written == next->size) {
+                prefetch(cliID, next);
+            }
+        }
+        if (*sent >= OFFLINE_REPLAY_BURST) {
+            return 1;
+        }
+        size_t  len = std::min(segment->size - spool->readOff, OFFLINE_REPLAY_BURST - *sent);
+        ssize_t n   = send(connfd, segment->map + spool->readOff, len, 0);
+        if (n < 0) {
+            return errno == EWOULDBLOCK ? 1 : -1;
+        }
+        spool->readOff += n;
+        *sent += n;
+        stored -= n;
+        if (spool->readOff == segment->size) {
+            logInfo(0, logfp, "RelayServer - client %u - replayed %u packets from segment %lu", cliID,
+                    segment->frames, segment->seq);
+            dropSegment(cliID, spool);
+        }
+    }
+    while (!spool->blocks.empty()) {
+        if (*sent >= OFFLINE_REPLAY_BURST) {
+            return 1;
+        }
+        Block*  block = &spool->blocks.front();
+        size_t  len   = std::min(block->data->size() - spool->readOff, OFFLINE_REPLAY_BURST - *sent);
+        ssize_t n     = send(connfd, block->data->data() + spool->readOff, len, 0);
+        if (n < 0) {
+            return errno == EWOULDBLOCK ? 1 : -1;
+        }
+        spool->readOff += n;
+        *sent += n;
+        stored -= n;
+        if (spool->readOff == block->data->size()) {
+            freeBlock(spool);
+        }
+    }
+    /* 发送方可能还有未完成的报文 */
+    if (spool->staging.empty() && !spool->dirty) {
+        spools.erase(it);
+    }
+    return 0;
+}
+
+/* I/O线程：取出所有请求，同一段文件的写入合并成一次writev，完成的请求放回完成队列 */
+void OfflineStore::ioLoop() {
+    OpenFiles               files;
+    std::vector<IoRequest>  batch;
+    std::vector<IoRequest*> writes;
+    std::deque<IoRequest>   done; /* 完成队列已满时暂存 */
+    int                     stop = 0;
+    while (!stop) {
+        struct pollfd pfd;
+        pfd.fd     = wakefd;
+        pfd.events = POLLIN;
+        if (poll(&pfd, 1, done.empty() ? -1 : 1) < 0 && errno != EINTR) {
+            logError(-1, logfp, "RelayServer - offline store - poll error");
+        }
+        uint64_t count;
+        if (read(wakefd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+            logError(-1, logfp, "RelayServer - offline store - read wake error");
+        }
+        batch.clear();
+        IoRequest request;
+        while (requests.pop(&request)) {
+            batch.push_back(request);
+        }
+        /* 写入先于同一批中的预读和删除执行：预读只针对已写完的段，删除只针对已回放的段 */
+        writes.clear();
+        for (IoRequest& r : batch) {
+            if (r.op == IO_WRITE) {
+                writes.push_back(&r);
+            }
+        }
+        std::stable_sort(writes.begin(), writes.end(), [](const IoRequest* a, const IoRequest* b) {
+            return a->cliID < b->cliID || (a->cliID == b->cliID && a->seq < b->seq);
+        });
+        for (size_t i = 0, j = 0; i < writes.size(); i = j) {
+            while (j < writes.size() && writes[j]->cliID == writes[i]->cliID && writes[j]->seq == writes[i]->seq) {
+                j++;
+            }
+            ioWrite(&writes[i], j - i, &files);
+        }
+        for (IoRequest& r : batch) {
+            if (r.op == IO_PREFETCH) {
+                ioPrefetch(&r);
+            }
+            else if (r.op == IO_DROP) {
+                ioDrop(&r, &files);
+            }
+            else if (r.op == IO_STOP) {
+                stop = 1;
+            }
+            if (r.op == IO_WRITE || r.op == IO_PREFETCH) {
+                done.push_back(r);
+            }
+        }
+        int pushed = 0;
+        while (!done.empty() && completions.push(done.front())) {
+            done.pop_front();
+            pushed = 1;
+        }
+        if (pushed) {
+            uint64_t one = 1;
+            if (write(notifyfd, &one, sizeof(one)) < 0) {
+                logError(-1, logfp, "RelayServer - offline store - notify error");
+            }
+        }
+    }
+    /* 事件循环已不再等待的结果 */
+    for (IoRequest& r : done) {
+        delete r.buffer;
+        if (r.map != nullptr) {
+            munmap(r.map, r.len);
+        }
+    }
+    for (auto& file : files) {
+        ::close(file.second.second);
+    }
+}
+
+/* 把同一段文件的count个写请求用writev一起写入，失败时截断到写入前的长度，这些请求都标记为失败 */
+void OfflineStore::ioWrite(IoRequest** batch, size_t count, OpenFiles* files) {
+    uint32_t cliID = batch[0]->cliID;
+    uint64_t seq   = batch[0]->seq;
+    auto     it    = files->find(cliID);
+    if (it != files->end() && it->second.first != seq) {
+        ::close(it->second.second); /* 之前的段已封闭 */
+        files->erase(it);
+        it = files->end();
+    }
+    if (it == files->end()) {
+        std::string name = segmentName(cliID, seq);
+        int         fd   = ::open(name.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+        if (fd < 0) {
+            logError(-1, logfp, "RelayServer - offline store - fail to open %s", name.c_str());
+            for (size_t i = 0; i < count; ++i) {
+                batch[i]->result = -1;
+            }
+            return;
+        }
+        it = files->insert(std::make_pair(cliID, std::make_pair(seq, fd))).first;
+    }
+    int         fd = it->second.second;
+    struct stat st;
+    off_t       before = fstat(fd, &st) < 0 ? 0 : st.st_size;
+    int         r      = 0;
+    for (size_t i = 0; i < count && r == 0; i += IO_IOV_MAX) {
+        struct iovec iov[IO_IOV_MAX];
+        int          cnt = 0;
+        for (size_t k = i; k < count && cnt < IO_IOV_MAX; ++k, ++cnt) {
+            iov[cnt].iov_base = batch[k]->buffer->data();
+            iov[cnt].iov_len  = batch[k]->buffer->size();
+        }
+        /* 处理部分写入：跳过已写完的iovec，调整第一个未写完的 */
+        struct iovec* cur = iov;
+        while (cnt > 0) {
+            ssize_t n = writev(fd, cur, cnt);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                r = -1;
+                break;
+            }
+            while (cnt > 0 && (size_t)n >= cur->iov_len) {
+                n -= cur->iov_len;
+                cur++;
+                cnt--;
+            }
+            if (cnt > 0) {
+                cur->iov_base = (char*)cur->iov_base + n;
+                cur->iov_len -= n;
+            }
+        }
+    }
+    if (r < 0) {
+        logError(-1, logfp, "RelayServer - offline store - client %u - write error", cliID);
+        if (ftruncate(fd, before) < 0) {
+            logError(-1, logfp, "RelayServer - offline store - client %u - truncate error", cliID);
+        }
+        for (size_t i = 0; i < count; ++i) {
+            batch[i]->result = -1;
+        }
+    }
+}
+
+/* 映射整个段文件，MAP_POPULATE在I/O线程中读入所有页面，事件循环发送时不会因缺页而阻塞 */
+void OfflineStore::ioPrefetch(IoRequest* request) {
+    std::string name = segmentName(request->cliID, request->seq);
+    int         fd   = ::open(name.c_str(), O_RDONLY);
+    void*       map  = MAP_FAILED;
+    if (fd >= 0) {
+        map = mmap(nullptr, request->len, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+        ::close(fd);
+    }
+    if (map == MAP_FAILED) {
+        logError(-1, logfp, "RelayServer - offline store - client %u - fail to map %s", request->cliID, name.c_str());
+        request->result = -1;
+        return;
+    }
+    madvise(map, request->len, MADV_SEQUENTIAL);
+    request->map = (char*)map;
+}
+
+void OfflineStore::ioDrop(IoRequest* request, OpenFiles* files) {
+    auto it = files->find(request->cliID);
+    if (it != files->end() && it->second.first == request->seq) {
+        ::close(it->second.second);
+        files->erase(it);
+    }
+    if (request->map != nullptr) {
+        munmap(request->map, request->len);
+    }
+    std::string name = segmentName(request->cliID, request->seq);
+    if (unlink(name.c_str()) < 0 && errno != ENOENT) {
+        logError(-1, logfp, "RelayServer - offline store - fail to remove %s", name.c_str());
+    }
+}
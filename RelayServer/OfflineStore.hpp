@@ -0,0 +1,199 @@
+#pragma once
+
+#include "../common/common.hpp"
+#include "RingBuffer.hpp"
+#include "SpscQueue.hpp"
+#include <atomic>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define OFFLINE_SEGMENT_SIZE (16 << 20)  /* 段文件达到该大小后换新段 */
+#define OFFLINE_BLOCK_SIZE (64 << 10)    /* 内存块的大小，暂存的完整报文超过该大小时立即放入内存块 */
+#define OFFLINE_REPLAY_BURST (256 << 10) /* 一次回放最多发送的字节数，避免一个客户端独占事件循环 */
+#define OFFLINE_QUEUE_SIZE 4096          /* 与I/O线程之间的请求队列和完成队列的长度，必须是2的幂 */
+#define IO_IOV_MAX 1024                  /* I/O线程一次writev最多合并的缓冲区数（不超过IOV_MAX） */
+#define OFFLINE_POLL_MS 50               /* 有内存块时事件循环的最长等待，其他Reactor可能使总量超出预算 */
+
+/* I/O线程的操作类型 */
+#define IO_WRITE 1    /* 把buffer追加到段文件，段文件不存在时创建 */
+#define IO_PREFETCH 2 /* 映射段文件并预读全部页面 */
+#define IO_DROP 3     /* 解除映射并删除段文件 */
+#define IO_STOP 4     /* 关闭所有文件后退出 */
+
+/* 事件循环交给I/O线程的请求，IO_WRITE和IO_PREFETCH完成后原样放回完成队列 */
+typedef struct IoRequest {
+    uint8_t            op;               /* 操作类型 */
+    int                result = 0;       /* 0表示成功，-1表示失败 */
+    uint32_t           cliID;            /* 接收方客户ID */
+    uint64_t           seq;              /* 段序号 */
+    std::vector<char>* buffer = nullptr; /* IO_WRITE要写入的数据，完成后交回事件循环释放 */
+    char*              map    = nullptr; /* IO_PREFETCH得到的映射，IO_DROP要解除的映射 */
+    size_t             len    = 0;       /* IO_PREFETCH和IO_DROP的映射长度 */
+} IoRequest;
+
+/* I/O线程中打开的段文件：接收方客户ID → (段序号, 文件描述符) */
+typedef std::map<uint32_t, std::pair<uint64_t, int>> OpenFiles;
+
+/* 段索引项：段文件中只有完整的报文，报文就是转发时的原始字节（报头 + 载荷） */
+typedef struct Segment {
+    uint64_t seq;                   /* 段序号，文件名为<目录>/<客户ID>.<序号>.seg */
+    size_t   size        = 0;       /* 已交给I/O线程写入的字节数 */
+    size_t   written     = 0;       /* I/O线程已写入文件的字节数 */
+    uint32_t frames      = 0;       /* 报文数 */
+    char*    map         = nullptr; /* 预读完成后的映射 */
+    uint8_t  prefetching = 0;       /* 是否已请求预读 */
+} Segment;
+
+/* 内存中的一块完整报文 */
+typedef struct Block {
+    std::vector<char>* data;   /* 完整报文，写入磁盘时整块交给I/O线程 */
+    uint32_t           frames; /* 报文数 */
+    uint64_t           seq;    /* 块序号，在BlockAge中识别该块 */
+} Block;
+
+/* 按创建时间排列的内存块，最旧的块最先写入磁盘 */
+typedef struct BlockAge {
+    uint64_t born;  /* 创建时间（纳秒） */
+    uint32_t cliID; /* 接收方客户ID */
+    uint64_t seq;   /* 块序号，块已回放或已写入磁盘时不再匹配 */
+} BlockAge;
+
+/* 一个接收方的离线消息：磁盘上的段在前，内存块在后，所有段中的报文都早于内存块中的报文 */
+typedef struct Spool {
+    std::deque<Segment> segments;      /* 段索引，front正在回放，back正在追加 */
+    std::deque<Block>   blocks;        /* 内存块，没有段时front正在回放 */
+    uint8_t             open      = 0; /* segments.back()是否还可以追加，回放前封闭 */
+    uint8_t             dirty     = 0; /* 是否在待写入列表中 */
+    uint8_t             waiting   = 0; /* 回放是否在等待I/O线程 */
+    uint64_t            nextSeq   = 0; /* 下一个段的序号 */
+    std::vector<char>   staging;       /* 等待写入文件的数据 */
+    size_t              committed = 0; /* staging中属于完整报文的字节数 */
+    uint32_t            staged    = 0; /* staging中完整报文的个数 */
+    size_t              readOff   = 0; /* 正在回放的段或内存块中已发送的字节数 */
+} Spool;
+
+/* 离线消息存储：对端不在线时，发给它的报文按接收方先放在内存块中，对端通常很快重连，
+ * 直接从内存回放，不经过磁盘。所有Reactor的内存块共用一个内存预算，超出预算或停留过久的块
+ * 从最旧的开始追加到只追加的二进制段文件中（没有指定目录时丢弃），回放时从段文件的映射发送。
+ * 每个Reactor一个实例，索引只在Reactor线程中维护；打开、写入、映射和删除文件都由
+ * 本实例的I/O线程完成，两者只通过无锁队列交换请求和缓冲区，慢速磁盘不会阻塞事件循环。
+ * 客户ID在重启后会重新分配，离线消息不跨越重启，close时删除所有段文件 */
+class OfflineStore {
+private:
+    int                        active = 0;       /* 是否已启用 */
+    std::string                dir;              /* 段文件所在目录，空表示不写磁盘 */
+    size_t                     budget = 0;       /* 所有Reactor的内存块总大小的上限 */
+    uint64_t                   maxAge = 0;       /* 内存块写入磁盘前最多停留的时间（纳秒） */
+    FILE*                      logfp  = nullptr; /* log文件指针 */
+    std::map<uint32_t, Spool>  spools;           /* 以接收方客户ID为键 */
+    std::vector<uint32_t>      dirtyIDs;         /* 有完整报文暂存、等待放入内存块的接收方 */
+    std::deque<BlockAge>       ages;             /* 本实例的内存块，按创建时间排列 */
+    uint64_t                   nextBlock = 0;    /* 下一个内存块的序号 */
+    size_t                     stored    = 0;    /* 尚未回放的完整报文字节数 */
+    size_t                     memory    = 0;    /* 本实例内存块的总大小 */
+    uint64_t                   spilled   = 0;    /* 写入磁盘的内存块字节数 */
+    uint64_t                   dropped   = 0;    /* 没有磁盘目录、超出预算而丢弃的字节数 */
+    static std::atomic<size_t> memoryUsed;       /* 所有Reactor的内存块总大小 */
+    std::atomic<uint64_t>      oldest;           /* 本实例最旧内存块的创建时间，没有时为UINT64_MAX */
+    static std::mutex          storesLock;       /* 保护stores链表 */
+    static OfflineStore*       stores;           /* 所有启用的实例组成的链表，用于找出全局最旧的内存块 */
+    OfflineStore*              nextStore;        /* stores链表中的下一个实例 */
+    SpscQueue<IoRequest>       requests;         /* 事件循环 → I/O线程 */
+    SpscQueue<IoRequest>       completions;      /* I/O线程 → 事件循环 */
+    std::deque<IoRequest>      backlog;          /* 请求队列已满时暂存的请求 */
+    int                        submitted = 0;    /* 本轮放入请求队列、尚未唤醒I/O线程的请求数 */
+    int                        wakefd    = -1;   /* 唤醒I/O线程的eventfd */
+    int                        notifyfd  = -1;   /* 通知事件循环有完成的请求的eventfd */
+    std::thread                thread;           /* I/O线程 */
+
+    std::string segmentName(uint32_t cliID, uint64_t seq) const;
+    void        submit(const IoRequest& request);
+    void        wake();
+    void        stage(uint32_t cliID, Spool* spool, uint64_t now);
+    void        pruneAges();
+    uint64_t    othersOldest() const;
+    void        spill(uint32_t cliID, Spool* spool);
+    void        freeBlock(Spool* spool);
+    void        writeSegment(uint32_t cliID, Spool* spool, std::vector<char>* buffer, uint32_t frames);
+    void        dropSegment(uint32_t cliID, Spool* spool);
+    void        prefetch(uint32_t cliID, Segment* segment);
+    void        ioLoop();
+    void        ioWrite(IoRequest** batch, size_t count, OpenFiles* files);
+    void        ioPrefetch(IoRequest* request);
+    void        ioDrop(IoRequest* request, OpenFiles* files);
+
+public:
+    OfflineStore()
+        : oldest(UINT64_MAX), nextStore(nullptr), requests(OFFLINE_QUEUE_SIZE), completions(OFFLINE_QUEUE_SIZE) {}
+
+    ~OfflineStore();
+
+    /* 启用存储：dir为nullptr时不写磁盘，否则目录不存在时创建，并启动I/O线程。
+     * budget为所有Reactor共用的内存预算（字节），maxAge为内存块最多停留的时间（纳秒） */
+    int open(const char* dir, size_t budget, uint64_t maxAge, FILE* logfp);
+
+    /* 删除所有段文件并停止I/O线程 */
+    void close();
+
+    bool enabled() const {
+        return active;
+    }
+
+    /* 有请求完成时可读的eventfd，由事件循环关注，不写磁盘时为-1 */
+    int notifyFd() const {
+        return notifyfd;
+    }
+
+    /* 在发给cliID的未完成报文后追加数据 */
+    void append(uint32_t cliID, const void* buf, size_t len);
+    void append(uint32_t cliID, const RingBuffer* ring, uint64_t pos, size_t len);
+
+    /* 报文已完整，之后可以回放 */
+    void commit(uint32_t cliID);
+
+    /* 丢弃未完成的报文（发送方中途离开） */
+    void rollback(uint32_t cliID);
+
+    /* 把本轮暂存的完整报文放入内存块，超出预算或停留过久的内存块交给I/O线程写入磁盘，
+     * 每轮事件循环结束时调用 */
+    void flush();
+
+    /* 事件循环等待事件的最长时间（毫秒），-1表示不需要定时醒来。有内存块时至少每OFFLINE_POLL_MS醒来一次，
+     * 最旧的块到期时立即醒来，空闲的Reactor也能按时写出过期的块、在超出预算时释放所占的全局预算 */
+    int timeout() const;
+
+    /* 处理I/O线程完成的请求，把因此可以继续回放的接收方放入ready */
+    void complete(std::vector<uint32_t>* ready);
+
+    /* 是否有发给cliID的完整报文等待回放 */
+    bool pending(uint32_t cliID) const;
+
+    /* 先从段文件的映射、再从内存块向connfd发送发给cliID的报文，最多发送OFFLINE_REPLAY_BURST字节。
+     * 返回值：0表示已全部发送，1表示还有数据（EAGAIN或达到上限），
+     * 2表示在等待I/O线程写入或预读，完成后cliID会出现在complete的结果中，-1表示发送错误 */
+    int replay(uint32_t cliID, int connfd, size_t* sent);
+
+    /* 尚未回放的字节数 */
+    size_t storedBytes() const {
+        return stored;
+    }
+
+    /* 本实例内存块的总大小 */
+    size_t memoryBytes() const {
+        return memory;
+    }
+
+    /* 写入磁盘的内存块字节数 */
+    uint64_t spilledBytes() const {
+        return spilled;
+    }
+
+    /* 超出预算而丢弃的字节数 */
+    uint64_t droppedBytes() const {
+        return dropped;
+    }
+};
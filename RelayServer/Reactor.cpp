@@ -0,0 +1,933 @@
+#include "Reactor.hpp"
+
+void addStatistics(Statistics* dst, const Statistics* src) {
+    dst->recvNoSpace += src->recvNoSpace;
+    dst->recvBytes += src->recvBytes;
+    dst->recvPackets += src->recvPackets;
+    dst->recvSuccess += src->recvSuccess;
+    dst->recvEAGAIN += src->recvEAGAIN;
+    dst->recvError += src->recvError;
+    dst->recvFINs += src->recvFINs;
+    dst->sendNoData += src->sendNoData;
+    dst->sendBytes += src->sendBytes;
+    dst->sendSuccess += src->sendSuccess;
+    dst->sendEAGAIN += src->sendEAGAIN;
+    dst->sendError += src->sendError;
+    dst->sendCutThrough += src->sendCutThrough;
+    dst->poolHits += src->poolHits;
+    dst->poolMisses += src->poolMisses;
+    dst->allocFailures += src->allocFailures;
+    /* 各Reactor的峰值出现在不同时刻，相加会高估，汇总时取最大值 */
+    dst->bufferPeak = std::max(dst->bufferPeak.load(), src->bufferPeak.load());
+    dst->connections += src->connections;
+    dst->sessions += src->sessions;
+    dst->bufferedBytes += src->bufferedBytes;
+    dst->offlineBytes += src->offlineBytes;
+    dst->replayBytes += src->replayBytes;
+    dst->offlineStored += src->offlineStored;
+    dst->offlineMemory += src->offlineMemory;
+    dst->offlineSpilled += src->offlineSpilled;
+    dst->offlineDropped += src->offlineDropped;
+    dst->roomFrames += src->roomFrames;
+    dst->roomDropped += src->roomDropped;
+    dst->roomBytes += src->roomBytes;
+    dst->pauseWatermark += src->pauseWatermark;
+    dst->pauseBudget += src->pauseBudget;
+    dst->recvSize.merge(src->recvSize);
+    dst->eventsPerWait.merge(src->eventsPerWait);
+}
+
+int64_t IdAllocator::acquire() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!freeIDs.empty()) {
+        uint32_t cliID = freeIDs.back();
+        freeIDs.pop_back();
+        return cliID;
+    }
+    if (highID > UINT32_MAX) {
+        return -1;
+    }
+    return highID++;
+}
+
+void IdAllocator::release(uint32_t cliID) {
+    std::lock_guard<std::mutex> lock(mutex);
+    freeIDs.push_back(cliID);
+}
+
+std::atomic<size_t> Reactor::bufferedTotal(0);
+
+Reactor::~Reactor() {
+    if (thread.joinable()) {
+        thread.join();
+    }
+    if (epollfd >= 0) {
+        close(epollfd);
+    }
+    if (dispatchfd[0] >= 0) {
+        close(dispatchfd[0]);
+        close(dispatchfd[1]);
+    }
+}
+
+int Reactor::start() {
+    /* 预分配本线程分到的连接对象，避免建立连接时调用malloc */
+    size_t prealloc = (config->prealloc + config->threads - 1) / config->threads;
+    clientPool.prealloc(prealloc);
+    if (config->room > 0) {
+        memberPool.prealloc(prealloc);
+    }
+    /* 同一时刻通常只有一部分会话有数据在途 */
+    if (bufferPool.prealloc(prealloc / 2) < 0) {
+        return logError(-1, logfp, "RelayServer - reactor %d - fail to preallocate buffers", index);
+    }
+    if (pipe(dispatchfd) < 0) {
+        return logError(-1, logfp, "RelayServer - reactor %d - pipe error", index);
+    }
+    setnonblocking(dispatchfd[0]);
+    /* 内核不支持io_uring时退回epoll，房间模式只由epoll后端实现 */
+    if (config->backend == BACKEND_URING && config->room > 0) {
+        logError(0, logfp, "RelayServer - reactor %d - room mode is not supported by io_uring backend, use epoll",
+                 index);
+    }
+    else if (config->backend == BACKEND_URING) {
+        if (initUring() < 0) {
+            logError(-1, logfp, "RelayServer - reactor %d - io_uring unavailable, fall back to epoll", index);
+        }
+        else {
+            if (config->offline != nullptr || config->offlineMemory > 0) {
+                logError(0, logfp, "RelayServer - reactor %d - offline store is not supported by io_uring backend",
+                         index);
+            }
+            /* io_uring后端只在对端积压URING_QUEUE_MAX个缓冲区时暂停接收，不参与全局预算 */
+            if (config->highWater > 0 || config->memoryBudget > 0) {
+                logError(0, logfp, "RelayServer - reactor %d - watermarks and memory budget are not supported by "
+                         "io_uring backend", index);
+            }
+            backend = BACKEND_URING;
+            thread  = std::thread(&Reactor::runUring, this);
+            return 0;
+        }
+    }
+    int offlineOn = config->offline != nullptr || config->offlineMemory > 0;
+    /* 房间模式的发送方从不积压（报文立即分发），没有可暂停的发送方，内存由每个成员的积压上限约束 */
+    if (config->room > 0 && (config->highWater > 0 || config->memoryBudget > 0)) {
+        logError(0, logfp, "RelayServer - reactor %d - watermarks and memory budget have no effect in room mode",
+                 index);
+    }
+    if (config->room > 0 && (offlineOn || config->relayMode == RELAY_SPLICE)) {
+        logError(0, logfp, "RelayServer - reactor %d - room mode relays by copy without offline store", index);
+    }
+    else if (offlineOn) {
+        if (offline.open(config->offline, config->offlineMemory, config->offlineAge * 1000000UL, logfp) < 0) {
+            return -1;
+        }
+    }
+    epollfd = epoll_create(1);
+    if (epollfd < 0) {
+        return logError(-1, logfp, "RelayServer - reactor %d - epoll_create error", index);
+    }
+    addfd(epollfd, dispatchfd[0], 0, 0);
+    if (offline.notifyFd() >= 0) {
+        addfd(epollfd, offline.notifyFd(), 0, 0);
+    }
+    events.resize(MAX_EVENT_NUMBER);
+    thread = std::thread(&Reactor::run, this);
+    return 0;
+}
+
+int Reactor::dispatch(int connfd, uint32_t cliID) {
+    Dispatch msg;
+    msg.connfd = connfd;
+    msg.cliID  = cliID;
+    /* 小于PIPE_BUF的写操作是原子的，多个Dispatch不会交错 */
+    if (write(dispatchfd[1], &msg, sizeof(msg)) != sizeof(msg)) {
+        return logError(-1, logfp, "RelayServer - reactor %d - dispatch error", index);
+    }
+    return 0;
+}
+
+void Reactor::stop() {
+    dispatch(-1, 0);
+}
+
+void Reactor::join() {
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+void Reactor::run() {
+    logInfo(0, logfp, "RelayServer - reactor %d - start", index);
+    while (true) {
+        /* 等待事件 */
+        int ready = epoll_wait(epollfd, events.data(), (int)events.size(), waitTimeout());
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            logError(0, logfp, "RelayServer - reactor %d - epoll_wait error", index);
+            shutdownAll();
+        }
+        else {
+            stats.eventsPerWait.observe(ready);
+        }
+        /* 处理事件 */
+        if (handleEvents(ready) < 0) {
+            shutdownAll();
+        }
+        offline.flush(); /* 本轮收到的离线报文一起交给I/O线程 */
+        publishGauges();
+        enforceBudget();
+        if (shutFlag) {
+            if (clientNum == 0) {
+                logInfo(0, logfp, "RelayServer - reactor %d - all connected sockets are closed", index);
+                prepareExit();
+                break;
+            }
+        }
+    }
+}
+
+int Reactor::handleDispatch() {
+    Dispatch msgs[64];
+    while (true) {
+        ssize_t n = read(dispatchfd[0], msgs, sizeof(msgs));
+        if (n < 0) {
+            if (errno == EWOULDBLOCK || errno == EINTR)
+                return 0;
+            return logError(-1, logfp, "RelayServer - reactor %d - read dispatch error", index);
+        }
+        for (size_t i = 0; i < (size_t)n / sizeof(Dispatch); ++i) {
+            if (msgs[i].connfd < 0) {
+                shutdownAll();
+            }
+            else {
+                addClient(msgs[i].connfd, msgs[i].cliID);
+            }
+        }
+    }
+}
+
+/* 是否有发往对端的数据尚未发送 */
+static int hasPending(const ClientInfo* client) {
+    return !client->ring.empty() || client->piped > 0;
+}
+
+/* 是否已没有空间接收数据，没有借用缓冲区时总能借到，管道在第一次接收时才创建 */
+static int recvFull(const ClientInfo* client, int splice) {
+    if (splice) {
+        return client->pipeSize > 0 && client->piped >= client->pipeSize;
+    }
+    return client->ring.attached() && client->ring.full();
+}
+
+/* 接收空间的容量：缓冲区当前级别的大小，或管道的实际容量（尚未创建时按SPLICE_PIPE_SIZE） */
+static size_t recvCapacity(const ClientInfo* client, int splice) {
+    if (splice) {
+        return client->pipeSize > 0 ? client->pipeSize : SPLICE_PIPE_SIZE;
+    }
+    return BufferPool::tierSize(client->tier);
+}
+
+/* 已接收、尚未发给对端的字节数 */
+static size_t pendingBytes(const ClientInfo* client) {
+    return client->ring.size() + client->piped;
+}
+
+/* 待发数据是否达到高水位：超过配置的高水位，或缓冲区（管道）已满，达到时暂停接收 */
+int Reactor::aboveHigh(const ClientInfo* client, int splice) const {
+    return recvFull(client, splice) || (config->highWater > 0 && pendingBytes(client) >= config->highWater);
+}
+
+/* 待发数据是否已降到低水位，之后恢复接收。低水位默认是高水位的一半，高水位默认是缓冲区（管道）的容量 */
+int Reactor::belowLow(const ClientInfo* client, int splice) const {
+    size_t cap  = recvCapacity(client, splice);
+    size_t high = config->highWater > 0 ? std::min(config->highWater, cap) : cap;
+    size_t low  = config->lowWater > 0 ? std::min(config->lowWater, high) : high / 2;
+    return pendingBytes(client) <= low;
+}
+
+/* 因高水位暂停接收 */
+void Reactor::pauseRecv(ClientInfo* client) {
+    if (client->epollIn) {
+        stats.pauseWatermark++;
+    }
+    watch(client, 0, client->epollOut);
+}
+
+/* 修改客户端关注的事件：达到高水位时不关注EPOLLIN，仅在有数据待发时关注EPOLLOUT，
+ * LT模式下同样如此，否则缓冲区满或无数据可发时epoll_wait会立即返回而空转 */
+void Reactor::watch(ClientInfo* client, int in, int out) {
+    if (client->epollIn == in && client->epollOut == out) {
+        return;
+    }
+    modfd(epollfd, client->connfd, in, out, config->epollMode == EPOLL_ET);
+    client->epollIn  = in;
+    client->epollOut = out;
+}
+
+/* 把src缓冲的数据发往dst的套接字，返回值同send */
+ssize_t Reactor::sendPending(ClientInfo* dst, ClientInfo* src) {
+    ssize_t n = src->ring.empty() ? spliceSend(dst, src) : src->ring.sendTo(dst->connfd);
+    if (n >= 0) {
+        stats.sendSuccess++;
+        stats.sendBytes += n;
+    }
+    else if (errno == EWOULDBLOCK) {
+        stats.sendEAGAIN++;
+    }
+    return n;
+}
+
+int Reactor::handleEvents(const int& number) {
+    int et = config->epollMode == EPOLL_ET;
+    for (int i = 0; i < number; ++i) {
+        int sockfd = events[i].data.fd;
+        /* 监听线程分发的新连接 */
+        if (sockfd == dispatchfd[0]) {
+            if (handleDispatch() < 0)
+                return -1;
+        }
+        /* 离线存储的I/O线程完成了请求 */
+        else if (sockfd == offline.notifyFd()) {
+            handleOffline();
+        }
+        /* 房间成员 */
+        else if (config->room > 0) {
+            assert((size_t)sockfd < clientFDs.size() && clientFDs[sockfd] != nullptr);
+            handleRoomEvent(clientFDs[sockfd], events[i].events);
+        }
+        /* 已连接套接字 */
+        else {
+            /* 初始检查与设置 */
+            assert((size_t)sockfd < clientFDs.size() && clientFDs[sockfd] != nullptr);
+            ClientInfo* selfC   = clientFDs[sockfd];
+            uint32_t    selfID  = selfC->cliID;
+            ClientInfo* peerC   = selfC->peer;
+            int         removed = 0;
+            /* 对端不在线或已关闭写（服务器正在退出）时收到的数据直接丢弃 */
+            int sink = peerC == nullptr || peerC->state == 1;
+            /* 是否零拷贝转发，写入离线存储的报文要经过consumeRing */
+            int splice = config->relayMode == RELAY_SPLICE && !sink && !selfC->spooling;
+            if (sink) {
+                selfC->ring.clear();
+                dropBuffer(selfC);
+                dropPiped(selfC);
+                watch(selfC, 1, selfC->epollOut);
+            }
+            /* 有数据可读，并且有空间可存 */
+            if (events[i].events & EPOLLIN) {
+                /* 需要接收时才借用缓冲区，缓冲区已满时升级到更大的一级 */
+                if (!splice) {
+                    if (holdBuffer(selfC) < 0) {
+                        removeClient(sockfd);
+                        continue;
+                    }
+                    if (selfC->ring.full()) {
+                        growBuffer(selfC);
+                    }
+                }
+                // 如果没有空间接收数据
+                if (aboveHigh(selfC, splice)) {
+                    stats.recvNoSpace++;
+                }
+                // 如果有空间可接收数据，ET模式下一直读到EAGAIN或达到高水位
+                while (!aboveHigh(selfC, splice)) {
+                    ssize_t n = splice ? spliceRecv(selfC) : selfC->ring.recvFrom(sockfd);
+                    if (n > 0 && splice) { /* 报头已在spliceRecv中处理 */
+                        stats.recvSuccess++;
+                        stats.recvBytes += n;
+                        stats.recvSize.observe(n);
+                        pipedBytes += n;
+                    }
+                    else if (n > 0) {
+                        stats.recvSuccess++;
+                        stats.recvBytes += n;
+                        stats.recvSize.observe(n);
+                        consumeRing(selfC, peerC, selfC->ring.writePos() - n, n); /* 从本次收到的数据开始解析 */
+                    }
+                    else if (n == 0) {
+                        stats.recvFINs++;
+                        logInfo(0, logfp, "RelayServer - client %u - receive FIN from client (id:%u)", selfID,
+                                selfC->id);
+                        if (selfC->state == 0) { /* 之前未关闭连接，则直接关闭写 */
+                            shutdown(sockfd, SHUT_WR);
+                        }
+                        else {
+                            shutdown(sockfd, SHUT_RD); /* 之前关闭了写，则把读关闭 */
+                        }
+                        /* 直接关闭写的一端，不再写了，因为数据可能源源不断地来，我们不知道还得写多少
+                         */
+                        removeClient(sockfd);
+                        removed = 1;
+                        break;
+                    }
+                    else {
+                        if (errno != EWOULDBLOCK) { /* 连接已经结束，直接close套接字 */
+                            stats.recvError++;
+                            logError(-1, logfp, "RelayServer - client %u - recv error (id:%u)", selfID, selfC->id);
+                            removeClient(sockfd);
+                            removed = 1;
+                        }
+                        else {
+                            stats.recvEAGAIN++;
+                            /* 零拷贝模式下EAGAIN也可能来自已满的管道，此时套接字中仍有数据，
+                             * 不再关注EPOLLIN，等对端发送后重新关注（ET模式下以此产生新的事件） */
+                            char c;
+                            if (splice && recv(sockfd, &c, 1, MSG_PEEK | MSG_DONTWAIT) > 0) {
+                                pauseRecv(selfC);
+                            }
+                        }
+                        break;
+                    }
+                    if (sink) {
+                        selfC->ring.clear();
+                    }
+                    else {
+                        /* 直通转发：收到数据后立即尝试发给对端，EAGAIN时才留在缓冲区等待EPOLLOUT。
+                         * 发送错误留给对端自己的事件处理，这里不能删除对端 */
+                        if (peerC->state != 1 && !peerC->replaying && hasPending(selfC)
+                            && sendPending(peerC, selfC) > 0) {
+                            stats.sendCutThrough++;
+                        }
+                        if (!splice && selfC->ring.full()) {
+                            growBuffer(selfC);
+                        }
+                    }
+                    if (!et) {
+                        break;
+                    }
+                }
+                if (removed) {
+                    continue; /* continue最外层的for */
+                }
+                dropBuffer(selfC);
+                /* 达到高水位时不再关注EPOLLIN，LT模式下也不会因缓冲区满而空转；有数据待发时让对端关注EPOLLOUT */
+                if (aboveHigh(selfC, splice)) {
+                    pauseRecv(selfC);
+                }
+                if (!sink && hasPending(selfC)) {
+                    watch(peerC, peerC->epollIn, 1);
+                }
+            }
+            /* 有数据需要发送，并且能够发送，并且未关闭写 */
+            if ((events[i].events & EPOLLOUT) && selfC->state != 1) {
+                /* 先回放离线消息，回放完之前对端的新数据留在对端的缓冲区中 */
+                if (selfC->replaying) {
+                    int r = replayOffline(selfC);
+                    if (r != 0) {
+                        continue;
+                    }
+                }
+                if (peerC != nullptr) {
+                    // 无数据可发送
+                    if (!hasPending(peerC)) {
+                        stats.sendNoData++;
+                    }
+                    // 有数据可发送，ET模式下一直发到EAGAIN或没有数据
+                    while (hasPending(peerC)) {
+                        ssize_t n = sendPending(selfC, peerC);
+                        if (n < 0) {
+                            if (errno != EWOULDBLOCK) { /* 连接已经结束，直接close套接字 */
+                                stats.sendError++;
+                                logError(-1, logfp, "RelayServer - client %u - send error (id:%u)", selfID, selfC->id);
+                                removeClient(sockfd);
+                                removed = 1;
+                            }
+                            break;
+                        }
+                        if (!et) {
+                            break;
+                        }
+                    }
+                    if (removed) {
+                        continue; /* continue最外层的for */
+                    }
+                    dropBuffer(peerC); /* 数据全部转发后归还缓冲区 */
+                }
+                // 如果有匹配的客户端
+                if (peerC != nullptr) {
+                    // 对端的待发数据降到低水位，恢复接收；因全局预算暂停的由enforceBudget恢复
+                    if (peerC->epollIn == 0 && !peerC->throttled && belowLow(peerC, splice)) {
+                        watch(peerC, 1, peerC->epollOut);
+                    }
+                    // 没有数据可发
+                    if (!hasPending(peerC)) {
+                        watch(selfC, selfC->epollIn, 0);
+                    }
+                }
+                else {
+                    watch(selfC, selfC->epollIn, 0);
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+void Reactor::shutdownAll() {
+    if (shutFlag) {
+        return;
+    }
+    shutFlag = 1;
+    for (ClientInfo* client : clientFDs) {
+        if (client != nullptr && client->state == 0) {
+            shutdown(client->connfd, SHUT_WR);
+            client->state = 1;
+        }
+        /* 对端都已关闭写，待发的数据不会再发出：丢弃并恢复接收，才能收到客户端的FIN */
+        if (client != nullptr && backend == BACKEND_EPOLL) {
+            client->ring.clear();
+            dropBuffer(client);
+            dropPiped(client);
+            client->throttled = 0;
+            watch(client, 1, 0);
+        }
+    }
+}
+
+ClientInfo* Reactor::newSlot() {
+    ClientInfo* client = clientPool.acquire();
+    *client            = ClientInfo();
+    return client;
+}
+
+void Reactor::freeSlot(ClientInfo* client) {
+    if (client->pipefd[0] >= 0) {
+        close(client->pipefd[0]);
+        close(client->pipefd[1]);
+        pipedBytes -= client->piped;
+    }
+    if (client->ring.attached()) {
+        bufferPool.release(client->ring.detach(), client->tier);
+    }
+    clientPool.release(client);
+}
+
+/* 借不到缓冲区时返回-1，由调用者断开客户端：没有缓冲区就无法接收，暂停接收后也没有事件能恢复它 */
+int Reactor::holdBuffer(ClientInfo* client) {
+    if (!client->ring.attached()) {
+        char* storage = bufferPool.acquire(client->tier);
+        if (storage == nullptr) {
+            stats.allocFailures++;
+            return logError(-1, logfp, "RelayServer - client %u - fail to allocate a receive buffer (id:%u)",
+                            client->cliID, client->id);
+        }
+        client->ring.attach(storage, BufferPool::tierSize(client->tier));
+    }
+    return 0;
+}
+
+/* 缓冲区中没有数据时归还，级别保留，下次借用同样大小的缓冲区 */
+void Reactor::dropBuffer(ClientInfo* client) {
+    if (client->ring.attached() && client->ring.empty()) {
+        bufferPool.release(client->ring.detach(), client->tier);
+    }
+}
+
+/* 借不到更大的缓冲区时保留原来的，与已达最高一级时一样等缓冲区腾出空间 */
+void Reactor::growBuffer(ClientInfo* client) {
+    if (client->tier + 1 >= BUFFER_TIERS) {
+        return;
+    }
+    char* storage = bufferPool.acquire(client->tier + 1);
+    if (storage == nullptr) {
+        stats.allocFailures++;
+        logError(0, logfp, "RelayServer - client %u - fail to enlarge the receive buffer (id:%u)", client->cliID,
+                 client->id);
+        return;
+    }
+    bufferPool.release(client->ring.migrate(storage, BufferPool::tierSize(client->tier + 1)), client->tier);
+    client->tier++;
+}
+
+/* 同一Reactor只分到1/threads的会话或房间，把全局ID压缩成本线程内连续的下标 */
+size_t Reactor::localIndex(uint32_t cliID) const {
+    size_t group = groupSize(*config);
+    return (size_t)(cliID / group) / config->threads * group + cliID % group;
+}
+
+int Reactor::addClient(int connfd, uint32_t cliID) {
+    ClientInfo* client = newSlot();
+    client->connfd     = connfd;
+    client->cliID      = cliID;
+    if ((size_t)connfd >= clientFDs.size()) {
+        clientFDs.resize(connfd + 1, nullptr);
+    }
+    size_t slot = localIndex(cliID);
+    if (slot >= clientIDs.size()) {
+        clientIDs.resize(slot + 2, nullptr);
+    }
+    assert(clientIDs[slot] == nullptr && clientFDs[connfd] == nullptr);
+    clientIDs[slot]   = client;
+    clientFDs[connfd] = client;
+    clientNum++;
+    /* 与同一会话的对端互相关联，房间模式下成员之间不直接关联 */
+    size_t peerSlot = localIndex(counterPart(cliID));
+    if (config->room > 0) {
+        client->room           = memberPool.acquire();
+        client->room->offset   = 0;
+        client->room->lag      = 0;
+        client->room->building = nullptr;
+        client->room->dirty    = 0;
+    }
+    else if (clientIDs[peerSlot] != nullptr) {
+        client->peer              = clientIDs[peerSlot];
+        clientIDs[peerSlot]->peer = client;
+        sessionNum++;
+    }
+    /* 在关闭过程中到达的连接直接关闭写的一端 */
+    if (shutFlag) {
+        shutdown(client->connfd, SHUT_WR);
+        client->state = 1;
+    }
+    /* 离线时收到的报文先回放，之后才转发对端的新数据 */
+    client->replaying = offline.pending(cliID);
+    if (backend == BACKEND_URING) {
+        setblocking(client->connfd); /* 非阻塞套接字上io_uring直接返回EAGAIN，而不是等待就绪 */
+        armRecv(client);
+    }
+    else {
+        /* 先只关注EPOLLIN，有数据待发时再关注EPOLLOUT */
+        addfd(epollfd, client->connfd, client->replaying, config->epollMode == EPOLL_ET);
+        client->epollOut = client->replaying;
+    }
+    logInfo(0, logfp, "RelayServer - client %u - new client (%zd in reactor %d)", cliID, clientNum, index);
+    return 0;
+}
+
+int Reactor::removeClient(const int& connfd) {
+    assert((size_t)connfd < clientFDs.size() && clientFDs[connfd] != nullptr);
+    ClientInfo* client = clientFDs[connfd];
+    uint32_t    cliID  = client->cliID;
+    uint32_t    id     = client->id;
+    if (client->spooling) {
+        offline.rollback(counterPart(cliID)); /* 丢弃写了一半的报文 */
+    }
+    if (client->room != nullptr) {
+        leaveRoom(client);
+    }
+    if (client->peer != nullptr) {
+        client->peer->peer      = nullptr;
+        client->peer->throttled = 0;
+        watch(client->peer, 1, client->peer->epollOut); /* 对端可能因缓冲区满而停止了读 */
+        sessionNum--;
+    }
+    freeSlot(client);
+    clientIDs[localIndex(cliID)] = nullptr;
+    clientFDs[connfd]            = nullptr;
+    clientNum--;
+    if (close(connfd) < 0) {
+        logError(-1, logfp, "RelayServer - client %u - close error", cliID);
+    }
+    delfd(epollfd, connfd);
+    allocator->release(cliID);
+    logInfo(0, logfp, "RelayServer - client %u - client left (id:%u) (%zd in reactor %d)", cliID, id, clientNum,
+            index);
+    return 0;
+}
+
+/* I/O线程完成了写入或预读，等待它的客户端重新关注EPOLLOUT继续回放 */
+void Reactor::handleOffline() {
+    offlineReady.clear();
+    offline.complete(&offlineReady);
+    for (uint32_t cliID : offlineReady) {
+        size_t      slot   = localIndex(cliID);
+        ClientInfo* client = slot < clientIDs.size() ? clientIDs[slot] : nullptr;
+        if (client != nullptr && client->cliID == cliID && client->replaying) {
+            watch(client, client->epollIn, 1);
+        }
+    }
+}
+
+/* 向selfC回放离线消息。返回值：0表示已全部回放，1表示还有数据，-1表示发送错误、客户端已删除 */
+int Reactor::replayOffline(ClientInfo* selfC) {
+    size_t sent;
+    int    r = offline.replay(selfC->cliID, selfC->connfd, &sent);
+    if (sent > 0) {
+        stats.sendSuccess++;
+        stats.sendBytes += sent;
+        stats.replayBytes += sent;
+    }
+    if (r < 0) {
+        stats.sendError++;
+        logError(-1, logfp, "RelayServer - client %u - replay error (id:%u)", selfC->cliID, selfC->id);
+        removeClient(selfC->connfd);
+        return -1;
+    }
+    if (r == 2) {
+        /* 等待I/O线程时不关注EPOLLOUT，LT模式下也不会空转，完成后由handleOffline重新关注 */
+        watch(selfC, selfC->epollIn, 0);
+        return 1;
+    }
+    if (r > 0) {
+        /* 达到单次回放的上限时套接字可能仍然可写，ET模式下重新修改一次，可写时立即再产生事件。
+         * 此时已关注EPOLLOUT，watch()会因状态未变而跳过，所以直接调用modfd */
+        if (config->epollMode == EPOLL_ET) {
+            modfd(epollfd, selfC->connfd, selfC->epollIn, 1, 1);
+            selfC->epollOut = 1;
+        }
+        return 1;
+    }
+    selfC->replaying = 0;
+    logInfo(0, logfp, "RelayServer - client %u - offline messages replayed", selfC->cliID);
+    return 0;
+}
+
+/* 报文边界状态机：在selfC->ring中[pos, pos + n)的新数据上推进recvFlag和unrecv，收齐报头时解析报头 */
+void Reactor::consumeRing(ClientInfo* selfC, ClientInfo* peerC, uint64_t pos, size_t n) {
+    uint32_t peerID = counterPart(selfC->cliID);
+    while (true) {
+        /* 在报文开始处决定该报文是转发还是写入离线存储，一个报文不会被拆开 */
+        if (selfC->recvFlag == 0 && selfC->unrecv == sizeof(Header)) {
+            selfC->spooling = peerC == nullptr && offline.enabled();
+        }
+        size_t len     = std::min(n, (size_t)selfC->unrecv);
+        int    partial = n < selfC->unrecv;
+        /* 报头或载荷接收完毕 */
+        if (!partial) {
+            // 处理报头
+            if (selfC->recvFlag == 0) {
+                selfC->ring.copyOut(pos, (char*)&selfC->header + (sizeof(Header) - selfC->unrecv), selfC->unrecv);
+                size_t msgLen = (size_t)handleHeader(&selfC->header, selfC);
+                stats.recvPackets++;
+                if (selfC->spooling) {
+                    offline.append(peerID, &selfC->header, sizeof(Header));
+                }
+                n               = n - selfC->unrecv;
+                pos             = pos + selfC->unrecv;
+                selfC->recvFlag = 1;
+                selfC->unrecv   = msgLen;
+            }
+            // 处理载荷
+            else {
+                if (selfC->spooling) {
+                    offline.append(peerID, &selfC->ring, pos, selfC->unrecv);
+                    offline.commit(peerID);
+                    stats.offlineBytes += sizeof(Header) + ntohs(selfC->header.length);
+                    /* 对端在报文中途上线，让它先回放这个报文 */
+                    if (peerC != nullptr) {
+                        peerC->replaying = 1;
+                        watch(peerC, peerC->epollIn, 1);
+                    }
+                }
+                n               = n - selfC->unrecv;
+                pos             = pos + selfC->unrecv;
+                selfC->recvFlag = 0;
+                selfC->unrecv   = sizeof(Header);
+            }
+        }
+        /* 只接受了一部分 */
+        else {
+            if (selfC->recvFlag == 0) {
+                selfC->ring.copyOut(pos, (char*)&selfC->header + (sizeof(Header) - selfC->unrecv), n);
+            }
+            else if (selfC->spooling) {
+                offline.append(peerID, &selfC->ring, pos, n);
+            }
+            selfC->unrecv = selfC->unrecv - n;
+        }
+        /* 对端在报文中途上线：该报文的其余部分已写入离线存储，不再转发 */
+        if (selfC->spooling && peerC != nullptr) {
+            selfC->ring.consume(len);
+        }
+        if (partial) {
+            break;
+        }
+    }
+}
+
+uint16_t Reactor::handleHeader(struct Header* header, ClientInfo* client) {
+    uint16_t msgLen = ntohs(header->length);
+    client->id      = ntohl(header->id);
+    if (logfp == nullptr)
+        return msgLen;
+    // struct timespec timestamp;
+    // timestamp.tv_sec  = ntoh64(header->sec);
+    // timestamp.tv_nsec = ntoh64(header->nsec);
+    // logInfo(0, logfp, "RelayServer - client %d - recv header: <length: %hd, id:
+    // %d, time: %s>", cliID, msgLen,
+    //         ntohl(header->id), strftTime(&timestamp).c_str());
+    return msgLen;
+}
+
+int Reactor::openPipe(ClientInfo* client) {
+    if (client->pipefd[0] >= 0) {
+        return 0;
+    }
+    if (pipe2(client->pipefd, O_NONBLOCK) < 0) {
+        return -1;
+    }
+    /* 扩大管道，小报文在管道中各占一个页槽。非特权用户的管道总大小超过pipe-user-pages-soft后会失败（EPERM），
+     * 管道保持默认甚至更小的容量，按实际容量判断管道是否已满 */
+    if (fcntl(client->pipefd[1], F_SETPIPE_SZ, SPLICE_PIPE_SIZE) < 0) {
+        logError(-1, logfp, "RelayServer - client %u - fail to enlarge pipe", client->cliID);
+    }
+    int size = fcntl(client->pipefd[1], F_GETPIPE_SZ);
+    if (size <= 0) {
+        close(client->pipefd[0]);
+        close(client->pipefd[1]);
+        client->pipefd[0] = client->pipefd[1] = -1;
+        return -1;
+    }
+    client->pipeSize = size;
+    return 0;
+}
+
+ssize_t Reactor::spliceRecv(ClientInfo* selfC) {
+    if (openPipe(selfC) < 0) { /* 管道在第一次接收时才创建，空闲会话不占用管道 */
+        return -1;
+    }
+    ssize_t total = 0;
+    while (selfC->piped < selfC->pipeSize) {
+        size_t len = selfC->unrecv;
+        /* 先窥探报头字节以解析报文长度，再把同样的字节移入管道 */
+        if (selfC->recvFlag == 0) {
+            ssize_t k = recv(selfC->connfd, (char*)&selfC->header + (sizeof(Header) - selfC->unrecv), selfC->unrecv,
+                             MSG_PEEK);
+            if (k <= 0) {
+                return total > 0 ? total : k;
+            }
+            len = k;
+        }
+        len       = std::min(len, (size_t)(selfC->pipeSize - selfC->piped));
+        ssize_t n = splice(selfC->connfd, NULL, selfC->pipefd[1], NULL, len, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        if (n <= 0) {
+            return total > 0 ? total : n;
+        }
+        total += n;
+        selfC->piped += n;
+        selfC->unrecv -= n;
+        if (selfC->unrecv == 0 && selfC->recvFlag == 0) {
+            selfC->unrecv   = handleHeader(&selfC->header, selfC);
+            selfC->recvFlag = 1;
+            stats.recvPackets++;
+        }
+        if (selfC->unrecv == 0 && selfC->recvFlag == 1) {
+            selfC->unrecv   = sizeof(Header);
+            selfC->recvFlag = 0;
+        }
+    }
+    return total;
+}
+
+ssize_t Reactor::spliceSend(ClientInfo* selfC, ClientInfo* peerC) {
+    ssize_t n = splice(peerC->pipefd[0], NULL, selfC->connfd, NULL, peerC->piped, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+    if (n > 0) {
+        peerC->piped -= n;
+        pipedBytes -= n;
+    }
+    return n;
+}
+
+void Reactor::dropPiped(ClientInfo* client) {
+    char discard[BUFFER_MIN_SIZE];
+    pipedBytes -= client->piped;
+    while (client->piped > 0) {
+        ssize_t n = read(client->pipefd[0], discard, std::min((size_t)client->piped, sizeof(discard)));
+        if (n <= 0) {
+            break;
+        }
+        client->piped -= n;
+    }
+    client->piped = 0;
+}
+
+/* 每轮事件循环结束时把只在本线程维护的状态发布到统计数据中，供指标线程读取 */
+void Reactor::publishGauges() {
+    stats.poolHits       = clientPool.hitCount() + bufferPool.hitCount() + memberPool.hitCount();
+    stats.poolMisses     = clientPool.missCount() + bufferPool.missCount() + memberPool.missCount();
+    stats.bufferPeak     = bufferPool.peakBytes();
+    stats.connections    = clientNum;
+    stats.sessions       = sessionNum;
+    stats.bufferedBytes  = bufferPool.inUseBytes() + pipedBytes + queuedBytes + roomBytes;
+    stats.offlineStored  = offline.storedBytes();
+    stats.offlineMemory  = offline.memoryBytes();
+    stats.offlineSpilled = offline.spilledBytes();
+    stats.offlineDropped = offline.droppedBytes();
+    stats.roomBytes      = roomBytes;
+    /* 把本Reactor缓冲字节数的变化计入全局总数，无符号数的回绕使减少也能正确累加；
+     * 不参与预算的Reactor不计入，否则它的缓冲会让其他Reactor暂停发送方 */
+    size_t buffered = budgeted() ? stats.bufferedBytes.load() : 0;
+    bufferedTotal.fetch_add(buffered - bufferedShare, std::memory_order_relaxed);
+    bufferedShare = buffered;
+}
+
+/* 是否参与全局内存预算：只有epoll后端的成对转发能按预算暂停积压的发送方 */
+int Reactor::budgeted() const {
+    return config->memoryBudget > 0 && backend == BACKEND_EPOLL && config->room == 0;
+}
+
+/* 全局内存预算：所有Reactor缓冲的字节数超过预算时，每个Reactor按自己所占的比例分担超出的部分，
+ * 从积压最多的发送方开始暂停接收，直到被暂停的发送方的积压之和覆盖分担的部分；
+ * 总数降到预算的7/8以下时全部恢复 */
+void Reactor::enforceBudget() {
+    if (!budgeted()) {
+        return;
+    }
+    size_t total = bufferedTotal.load(std::memory_order_relaxed);
+    if (total > config->memoryBudget) {
+        /* 扫描并排序所有客户端的代价与连接数成正比，超预算期间限制扫描频率 */
+        uint64_t now = nowNs();
+        if (now - budgetScan < (uint64_t)BUDGET_POLL_MS * 1000000) {
+            return;
+        }
+        budgetScan = now;
+
+        size_t share   = (size_t)((double)(total - config->memoryBudget) * bufferedShare / total);
+        size_t covered = 0;
+        heaviest.clear();
+        for (ClientInfo* client : clientFDs) {
+            if (client == nullptr) {
+                continue;
+            }
+            if (client->throttled) {
+                covered += pendingBytes(client);
+            }
+            else if (client->epollIn && pendingBytes(client) > 0) {
+                heaviest.push_back(client);
+            }
+        }
+        std::sort(heaviest.begin(), heaviest.end(),
+                  [](const ClientInfo* a, const ClientInfo* b) { return pendingBytes(a) > pendingBytes(b); });
+        for (ClientInfo* client : heaviest) {
+            if (covered >= share) {
+                break;
+            }
+            covered += pendingBytes(client);
+            client->throttled = 1;
+            watch(client, 0, client->epollOut);
+            throttledIDs.push_back(client->cliID);
+            stats.pauseBudget++;
+        }
+    }
+    else if (!throttledIDs.empty() && total <= config->memoryBudget / 8 * 7) {
+        for (uint32_t cliID : throttledIDs) {
+            size_t      slot   = localIndex(cliID);
+            ClientInfo* client = slot < clientIDs.size() ? clientIDs[slot] : nullptr;
+            /* 仍在高水位以上的发送方在下一次EPOLLIN时重新暂停 */
+            if (client != nullptr && client->cliID == cliID && client->throttled) {
+                client->throttled = 0;
+                watch(client, 1, client->epollOut);
+            }
+        }
+        throttledIDs.clear();
+    }
+}
+
+/* epoll_wait的超时：有发送方因全局预算暂停时，总数可能因其他Reactor释放内存而下降，本线程空闲时也要定期醒来检查；
+ * 离线存储有内存块时按它的要求醒来 */
+int Reactor::waitTimeout() const {
+    int timeout = offline.timeout();
+    if (!throttledIDs.empty() && (timeout < 0 || timeout > BUDGET_POLL_MS)) {
+        timeout = BUDGET_POLL_MS;
+    }
+    return timeout;
+}
+
+void Reactor::prepareExit() {
+    publishGauges();
+    offline.close();
+    logInfo(0, logfp, "RelayServer - reactor %d - offline segments are deleted", index);
+}
@@ -0,0 +1,265 @@
+#pragma once
+
+#include "../common/common.hpp"
+#include "BufferPool.hpp"
+#include "Metrics.hpp"
+#include "ObjectPool.hpp"
+#include "OfflineStore.hpp"
+#include "RingBuffer.hpp"
+#include "ServerConfig.hpp"
+#include "Uring.hpp"
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define POOL_MAX_FREE 1024      /* 对象池在预分配之外最多保留的空闲对象数 */
+#define SPLICE_PIPE_SIZE 262144 /* 零拷贝模式下每个客户端管道的容量 */
+#define URING_ENTRIES 4096      /* io_uring提交队列长度 */
+#define URING_BUF_COUNT 1024    /* io_uring提供缓冲区个数，必须是2的幂 */
+#define URING_BUF_SIZE 4096     /* io_uring每个提供缓冲区的大小 */
+#define URING_QUEUE_MAX 16      /* 对端待发送缓冲区超过该数量时暂停接收 */
+#define ROOM_IOV_MAX 64         /* 房间模式下一次writev最多发送的报文数 */
+#define BUDGET_POLL_MS 10       /* 全局预算：有发送方被暂停时epoll_wait的最长等待，也是超预算时两次扫描的最小间隔 */
+
+/* io_uring操作类型，保存在user_data的低3位，高位是ClientInfo指针 */
+#define URING_DISPATCH 1
+#define URING_RECV 2
+#define URING_SEND 3
+#define URING_ACCEPT 4
+#define URING_OP_MASK 7ULL
+
+/* 房间模式下共享的报文：收齐后只保存一份，被房间内其他成员的发送队列引用，
+ * 报文字节紧跟在本结构之后 */
+typedef struct SharedFrame {
+    uint32_t refs;   /* 引用计数，为0时释放 */
+    uint32_t len;    /* 报文长度（报头 + 载荷） */
+    uint32_t filled; /* 已收到的字节数 */
+
+    char* data() {
+        return (char*)(this + 1);
+    }
+} SharedFrame;
+
+/* 房间模式下一个成员的收发状态，只在房间模式下分配 */
+typedef struct RoomMember {
+    std::deque<SharedFrame*> queue;              /* 等待发给本成员的报文 */
+    size_t                   offset   = 0;       /* queue.front()中已发送的字节数 */
+    size_t                   lag      = 0;       /* 队列中尚未发送的字节数 */
+    SharedFrame*             building = nullptr; /* 本成员正在发送给房间的报文 */
+    uint8_t                  dirty    = 0;       /* 是否在待发送列表中 */
+} RoomMember;
+
+/* 客户端状态：只保存转发路径上频繁访问的字段，集中存放在紧凑的槽位数组中。
+ * 接收缓冲区只在有数据待转发时从BufferPool借用，空闲的客户端只占用本结构 */
+typedef struct ClientInfo {
+    uint32_t    cliID;                      /* 客户ID（仅用于服务器区分客户端） */
+    int         connfd;                     /* 套接字文件描述符 */
+    uint8_t     state     = 0;              /* 0:未关闭套接字 1:已关闭写的一端 */
+    uint8_t     recvFlag  = 0;              /* 0: 正在接收头部，非0：正在接收载荷 */
+    uint8_t     epollIn   = 1;              /* 是否关注EPOLLIN，达到高水位时暂停接收 */
+    uint8_t     epollOut  = 0;              /* 是否关注EPOLLOUT，只在有待发送数据时关注（LT和ET相同） */
+    uint8_t     tier      = 0;              /* 接收缓冲区的级别，缓冲区满时升级 */
+    uint8_t     closing   = 0;              /* io_uring模式下正在等待操作完成后关闭 */
+    uint8_t     recvArmed = 0;              /* io_uring模式下是否已提交接收 */
+    uint8_t     spooling  = 0;              /* 正在接收的报文写入离线存储而不是转发 */
+    uint8_t     replaying = 0;              /* 有离线消息待回放，回放完之前不向本客户端转发新数据 */
+    uint8_t     throttled = 0;              /* 因超出全局内存预算而暂停接收 */
+    uint32_t    unrecv    = sizeof(Header); /* 期望接收的数据大小（仅用于判断是否读到报文头） */
+    RingBuffer  ring;                       /* 已接收、等待转发的数据 */
+    ClientInfo* peer     = nullptr;         /* 同一会话的对端客户端，不存在时为nullptr */
+    RoomMember* room     = nullptr;         /* 房间模式下的成员状态 */
+    uint32_t    id;                         /* 报文中的id，DEBUG用 */
+    Header      header;                     /* 正在接收报文的报头 */
+    int         pipefd[2]    = { -1, -1 };  /* 零拷贝模式下发往对端的数据所在的管道，首次接收时创建 */
+    uint32_t    piped        = 0;           /* 管道中的数据量 */
+    uint32_t    pipeSize     = 0;           /* 管道的实际容量，扩大失败时小于SPLICE_PIPE_SIZE */
+    int         inflight     = 0;           /* io_uring中尚未完成的操作数 */
+    int         sendHead     = -1;          /* io_uring模式下待发送缓冲区队列头 */
+    int         sendTail     = -1;          /* io_uring模式下待发送缓冲区队列尾 */
+    int         sendQueued   = 0;           /* 队列中的缓冲区数（包括已提交的） */
+    int         sendInflight = 0;           /* 已提交、尚未完成的发送数 */
+} ClientInfo;
+
+/* 监听线程交给Reactor线程的新连接，connfd为-1表示通知Reactor退出 */
+typedef struct Dispatch {
+    int      connfd; /* 已连接套接字 */
+    uint32_t cliID;  /* 分配的客户ID */
+} Dispatch;
+
+/* 统计数据，每个Reactor线程各自一份，由本线程写入，指标线程随时读取，退出时汇总 */
+typedef struct Statistics {
+    Counter   recvNoSpace;    /* 可以接收但没有足够的应用缓冲区的次数 */
+    Counter   recvBytes;      /* 接收到的数据数量 */
+    Counter   recvPackets;    /* 收到到报文数量 */
+    Counter   recvSuccess;    /* 接收到数据的次数 */
+    Counter   recvEAGAIN;     /* recv 返回EWOULDBLOCK的次数 */
+    Counter   recvError;      /* recv 返回其他错误的次数 */
+    Counter   recvFINs;       /* recv 返回0的次数 */
+    Counter   sendNoData;     /* 可写但无数据可发的次数 */
+    Counter   sendBytes;      /* 发送的数据量 */
+    Counter   sendSuccess;    /* 成功发送数据的次数 */
+    Counter   sendEAGAIN;     /* send 返回EWOULDBLOCK的次数 */
+    Counter   sendError;      /* send 返回其他错误的次数 */
+    Counter   sendCutThrough; /* 收到数据后立即发给对端的次数 */
+    Counter   poolHits;       /* 从对象池空闲链表取得对象的次数 */
+    Counter   poolMisses;     /* 对象池为空、从堆分配的次数 */
+    Counter   allocFailures;  /* 内存分配失败、丢弃数据或断开客户端的次数 */
+    Counter   bufferPeak;     /* 本Reactor同时借出的接收缓冲区字节数峰值，汇总时取最大值 */
+    Counter   connections;    /* 当前连接数 */
+    Counter   sessions;       /* 当前两端都已连接的会话数 */
+    Counter   bufferedBytes;  /* 当前借出的接收缓冲区、管道和io_uring发送队列中的字节数 */
+    Counter   offlineBytes;   /* 写入离线存储的报文字节数 */
+    Counter   replayBytes;    /* 从离线存储回放的字节数 */
+    Counter   offlineStored;  /* 当前离线存储中尚未回放的字节数 */
+    Counter   offlineMemory;  /* 当前离线存储内存块的总大小 */
+    Counter   offlineSpilled; /* 离线存储从内存写入磁盘的字节数 */
+    Counter   offlineDropped; /* 没有离线目录、超出内存预算而丢弃的字节数 */
+    Counter   roomFrames;     /* 房间模式下收到并分发的报文数 */
+    Counter   roomDropped;    /* 房间模式下因成员积压超过上限而没有发给它的报文数 */
+    Counter   roomBytes;      /* 当前房间模式下共享报文的总字节数 */
+    Counter   pauseWatermark; /* 待发数据达到高水位而暂停接收的次数 */
+    Counter   pauseBudget;    /* 超出全局内存预算、积压最多的发送方被暂停接收的次数 */
+    Histogram recvSize;       /* 每次接收到的字节数 */
+    Histogram eventsPerWait;  /* 每次epoll_wait（或io_uring_enter）返回的事件数 */
+} Statistics;
+
+/* 将src中的统计数据累加到dst */
+void addStatistics(Statistics* dst, const Statistics* src);
+
+/* 全局客户ID分配器：监听线程分配ID，Reactor线程在客户离开时归还ID。
+ * 归还的ID放入空闲链表，分配和归还都是O(1) */
+class IdAllocator {
+private:
+    std::mutex            mutex;      /* 仅在accept和关闭连接时加锁，不在转发路径上 */
+    std::vector<uint32_t> freeIDs;    /* 已归还、可重新分配的ID */
+    uint64_t              highID = 0; /* 从未分配过的最小ID */
+
+public:
+    /* 优先复用最近归还的ID，没有可用ID时返回-1 */
+    int64_t acquire();
+
+    /* 归还ID */
+    void release(uint32_t cliID);
+};
+
+/* 一个Reactor线程：独立的事件循环（epoll或io_uring）、客户端集合、对象池和统计数据。
+ * 同一会话的两个客户端（cliID与counterPart(cliID)）或同一房间的所有成员总是被分到同一个Reactor，
+ * 因此转发路径不需要任何锁 */
+class Reactor {
+    friend class RelayBench; /* 微基准测试直接调用转发路径上的私有函数 */
+
+private:
+    int                             index;                      /* Reactor编号 */
+    const ServerConfig*             config;                     /* 服务器配置 */
+    IdAllocator*                    allocator;                  /* 全局ID分配器 */
+    FILE*                           logfp = nullptr;            /* log文件指针 */
+    std::vector<ClientInfo*>        clientIDs;                  /* 以客户ID为下标的客户端表 */
+    std::vector<ClientInfo*>        clientFDs;                  /* 以套接字为下标的客户端表 */
+    ObjectPool<ClientInfo>          clientPool;                 /* 客户端状态池 */
+    ObjectPool<RoomMember>          memberPool;                 /* 房间成员状态池 */
+    BufferPool                      bufferPool;                 /* 分级接收缓冲区池 */
+    size_t                          clientNum   = 0;            /* 已连接客户端数量 */
+    size_t                          sessionNum  = 0;            /* 两端都已连接的会话数量 */
+    size_t                          pipedBytes  = 0;            /* 零拷贝模式下所有管道中的数据量 */
+    size_t                          queuedBytes = 0;            /* io_uring模式下所有发送队列中的数据量 */
+    OfflineStore                    offline;                    /* 对端不在线时的离线消息 */
+    std::vector<uint32_t>           offlineReady;               /* 离线消息可以继续回放的客户端 */
+    std::vector<ClientInfo*>        roomDirty;                  /* 本次接收后有新报文待发的房间成员 */
+    size_t                          roomBytes     = 0;          /* 房间模式下所有共享报文的字节数 */
+    size_t                          bufferedShare = 0;          /* 本Reactor计入bufferedTotal的字节数 */
+    std::vector<uint32_t>           throttledIDs;               /* 因全局内存预算暂停接收的客户端 */
+    std::vector<ClientInfo*>        heaviest;                   /* enforceBudget中按积压排序的发送方 */
+    uint64_t                        budgetScan = 0;             /* 上一次超预算扫描的时间（纳秒） */
+    static std::atomic<size_t>      bufferedTotal;              /* 所有Reactor缓冲的字节数 */
+    std::vector<struct epoll_event> events;                     /* epoll_wait返回的事件 */
+    std::thread                     thread;                     /* 运行事件循环的线程 */
+    int                             epollfd       = -1;         /* epoll描述符 */
+    int                             dispatchfd[2] = { -1, -1 }; /* 接收新连接的管道 */
+    int                             shutFlag      = 0;          /* 是否已经把所有套接字写的一端关闭 */
+    Statistics                      stats;                      /* 本线程的统计数据 */
+    int                             backend = BACKEND_EPOLL;    /* 实际使用的事件循环后端 */
+    Uring                           uring;                      /* io_uring后端的队列 */
+    BufRing                         bufRing;                    /* io_uring后端的提供缓冲区 */
+    std::vector<int>                bufNext;                    /* 发送队列中下一个缓冲区 */
+    std::vector<uint32_t>           bufLen;                     /* 缓冲区中的数据量 */
+    std::vector<ClientInfo*>        starved;                    /* 因缺少提供缓冲区而暂停接收的客户端 */
+    std::vector<ClientInfo*>        deferredRecv;               /* 提交队列已满时未能发起接收的客户端 */
+    std::vector<ClientInfo*>        deferredSend;               /* 提交队列已满时未能发起发送的客户端 */
+    int                             dispatchDeferred = 0;       /* 提交队列已满时未能监听分发管道 */
+
+    void        run();
+    int         handleEvents(const int& number);
+    void        watch(ClientInfo* client, int in, int out);
+    int         aboveHigh(const ClientInfo* client, int splice) const;
+    int         belowLow(const ClientInfo* client, int splice) const;
+    void        pauseRecv(ClientInfo* client);
+    int         budgeted() const;
+    void        enforceBudget();
+    int         waitTimeout() const;
+    ssize_t     sendPending(ClientInfo* dst, ClientInfo* src);
+    int         handleDispatch();
+    void        shutdownAll();
+    void        prepareExit();
+    void        publishGauges();
+    int         addClient(int connfd, uint32_t cliID);
+    size_t      localIndex(uint32_t cliID) const;
+    int         removeClient(const int& connfd);
+    ClientInfo* newSlot();
+    void        freeSlot(ClientInfo* client);
+    int         holdBuffer(ClientInfo* client);
+    void        dropBuffer(ClientInfo* client);
+    void        growBuffer(ClientInfo* client);
+    int         replayOffline(ClientInfo* selfC);
+    void        handleOffline();
+    void        consumeRing(ClientInfo* selfC, ClientInfo* peerC, uint64_t pos, size_t n);
+    uint16_t    handleHeader(struct Header* header, ClientInfo* client);
+    int         openPipe(ClientInfo* client);
+    ssize_t     spliceRecv(ClientInfo* selfC);
+    ssize_t     spliceSend(ClientInfo* selfC, ClientInfo* peerC);
+    void        dropPiped(ClientInfo* client);
+    int         initUring();
+    void        runUring();
+    void        handleCompletion(struct io_uring_cqe* cqe);
+    void        armDispatch();
+    int         retryDeferred();
+    void        armRecv(ClientInfo* client);
+    void        flushSend(ClientInfo* client);
+    void        recycleBuffer(int bid);
+    void        consumeFrames(ClientInfo* client, const char* data, size_t n);
+    int         removeUringClient(ClientInfo* client);
+    void        finalizeUringClient(ClientInfo* client);
+    void        handleRoomEvent(ClientInfo* selfC, uint32_t events);
+    void        consumeRoom(ClientInfo* selfC, uint64_t pos, size_t n);
+    void        publishFrame(ClientInfo* selfC, SharedFrame* frame);
+    void        flushRoom();
+    ssize_t     sendFrames(ClientInfo* client);
+    void        releaseFrame(SharedFrame* frame);
+    void        leaveRoom(ClientInfo* client);
+
+public:
+    Reactor(int index, const ServerConfig* config, IdAllocator* allocator, FILE* logfp)
+        : index(index), config(config), allocator(allocator), logfp(logfp), clientPool(POOL_MAX_FREE),
+          memberPool(POOL_MAX_FREE) {}
+
+    ~Reactor();
+
+    /* 创建epoll事件表与分发管道并启动线程 */
+    int start();
+
+    /* 把新连接交给本Reactor（由监听线程调用） */
+    int dispatch(int connfd, uint32_t cliID);
+
+    /* 通知本Reactor关闭所有连接后退出（由监听线程调用） */
+    void stop();
+
+    /* 等待线程结束 */
+    void join();
+
+    const Statistics& statistics() const {
+        return stats;
+    }
+};
@@ -0,0 +1,237 @@
+#include "Reactor.hpp"
+
+/* 房间模式：连续的groupSize个客户ID组成一个房间，任一成员发出的报文转发给房间内其他所有成员。
+ * 报文在接收时只复制一次到引用计数的SharedFrame中，各成员的发送队列只保存指针，
+ * 内存随不同报文的数量增长，而不是随报文数 × 成员数增长。发送时把队列中的多个报文用一次writev发出。
+ * 积压超过roomLag的成员不再收到新报文，慢速成员不会拖慢发送方，也不会让内存无限增长 */
+
+void Reactor::handleRoomEvent(ClientInfo* selfC, uint32_t events) {
+    int      et     = config->epollMode == EPOLL_ET;
+    int      sockfd = selfC->connfd;
+    uint32_t selfID = selfC->cliID;
+    /* 有数据可读：每次收到的数据立即解析，收齐的报文放入其他成员的发送队列，接收缓冲区总是被清空 */
+    if (events & EPOLLIN) {
+        if (holdBuffer(selfC) < 0) {
+            removeClient(sockfd);
+            return;
+        }
+        while (true) {
+            ssize_t n = selfC->ring.recvFrom(sockfd);
+            if (n > 0) {
+                stats.recvSuccess++;
+                stats.recvBytes += n;
+                stats.recvSize.observe(n);
+                consumeRoom(selfC, selfC->ring.writePos() - n, n);
+                flushRoom();
+                /* 一次读满缓冲区时换用更大的一级，缓冲区此时为空，不需要搬移数据 */
+                if ((size_t)n == selfC->ring.capacity()) {
+                    growBuffer(selfC);
+                }
+            }
+            else if (n == 0) {
+                stats.recvFINs++;
+                logInfo(0, logfp, "RelayServer - client %u - receive FIN from client (id:%u)", selfID, selfC->id);
+                shutdown(sockfd, selfC->state == 0 ? SHUT_WR : SHUT_RD);
+                removeClient(sockfd);
+                return;
+            }
+            else {
+                if (errno != EWOULDBLOCK) {
+                    stats.recvError++;
+                    logError(-1, logfp, "RelayServer - client %u - recv error (id:%u)", selfID, selfC->id);
+                    removeClient(sockfd);
+                    return;
+                }
+                stats.recvEAGAIN++;
+                break;
+            }
+            if (!et) {
+                break;
+            }
+        }
+        dropBuffer(selfC);
+    }
+    /* 可写：发送队列中的报文，ET模式下一直发到EAGAIN或队列为空 */
+    if ((events & EPOLLOUT) && selfC->state != 1) {
+        RoomMember* member = selfC->room;
+        if (member->queue.empty()) {
+            stats.sendNoData++;
+        }
+        while (!member->queue.empty()) {
+            if (sendFrames(selfC) < 0) {
+                if (errno != EWOULDBLOCK) {
+                    stats.sendError++;
+                    logError(-1, logfp, "RelayServer - client %u - send error (id:%u)", selfID, selfC->id);
+                    removeClient(sockfd);
+                    return;
+                }
+                break;
+            }
+            if (!et) {
+                break;
+            }
+        }
+        if (member->queue.empty()) {
+            watch(selfC, selfC->epollIn, 0);
+        }
+    }
+}
+
+/* 报文边界状态机：把selfC->ring中[pos, pos + n)的新数据复制到正在接收的SharedFrame中，
+ * 报头收齐时按载荷长度分配SharedFrame，载荷收齐时分发给房间内的其他成员 */
+void Reactor::consumeRoom(ClientInfo* selfC, uint64_t pos, size_t n) {
+    RoomMember* member = selfC->room;
+    selfC->ring.consume(n); /* 数据在本函数返回前复制完，缓冲区中不会写入新数据 */
+    while (n > 0) {
+        size_t len = std::min(n, (size_t)selfC->unrecv);
+        if (selfC->recvFlag == 0) {
+            selfC->ring.copyOut(pos, (char*)&selfC->header + (sizeof(Header) - selfC->unrecv), len);
+        }
+        else if (member->building != nullptr) { /* 分配失败的报文只跳过载荷 */
+            SharedFrame* frame = member->building;
+            selfC->ring.copyOut(pos, frame->data() + frame->filled, len);
+            frame->filled += len;
+        }
+        pos += len;
+        n -= len;
+        selfC->unrecv -= len;
+        /* 报头或载荷只接收了一部分 */
+        if (selfC->unrecv > 0) {
+            break;
+        }
+        // 处理报头
+        if (selfC->recvFlag == 0) {
+            size_t       msgLen = (size_t)handleHeader(&selfC->header, selfC);
+            SharedFrame* frame  = (SharedFrame*)malloc(sizeof(SharedFrame) + sizeof(Header) + msgLen);
+            if (frame != nullptr) {
+                frame->refs   = 1; /* 接收方持有的引用，分发后释放 */
+                frame->len    = sizeof(Header) + msgLen;
+                frame->filled = sizeof(Header);
+                memcpy(frame->data(), &selfC->header, sizeof(Header));
+                roomBytes += frame->len;
+            }
+            else {
+                /* 内存不足时丢弃这个报文，继续按报文边界接收后面的报文 */
+                stats.allocFailures++;
+                logError(-1, logfp, "RelayServer - client %u - fail to allocate a room frame, drop it (id:%u)",
+                         selfC->cliID, selfC->id);
+            }
+            stats.recvPackets++;
+            member->building = frame;
+            selfC->recvFlag  = 1;
+            selfC->unrecv    = msgLen;
+        }
+        // 载荷接收完毕（载荷可能为空）
+        if (selfC->recvFlag == 1 && selfC->unrecv == 0) {
+            if (member->building != nullptr) {
+                publishFrame(selfC, member->building);
+            }
+            member->building = nullptr;
+            selfC->recvFlag  = 0;
+            selfC->unrecv    = sizeof(Header);
+        }
+    }
+}
+
+/* 把收齐的报文放入房间内其他成员的发送队列，积压超过上限的成员跳过这个报文 */
+void Reactor::publishFrame(ClientInfo* selfC, SharedFrame* frame) {
+    uint32_t first = selfC->cliID - selfC->cliID % config->room;
+    stats.roomFrames++;
+    for (uint32_t cliID = first; cliID < first + (uint32_t)config->room; ++cliID) {
+        size_t      slot   = localIndex(cliID);
+        ClientInfo* client = slot < clientIDs.size() ? clientIDs[slot] : nullptr;
+        if (client == nullptr || client == selfC || client->state == 1) {
+            continue;
+        }
+        RoomMember* member = client->room;
+        /* 队列为空时总是接受，上限小于一个报文时成员仍能收到数据 */
+        if (!member->queue.empty() && member->lag + frame->len > config->roomLag) {
+            stats.roomDropped++;
+            continue;
+        }
+        frame->refs++;
+        member->queue.push_back(frame);
+        member->lag += frame->len;
+        if (!member->dirty) {
+            member->dirty = 1;
+            roomDirty.push_back(client);
+        }
+    }
+    releaseFrame(frame);
+}
+
+/* 直通转发：本次接收后有新报文的成员立即尝试发送，EAGAIN时才等待EPOLLOUT。
+ * 发送错误留给该成员自己的事件处理，这里不能删除它 */
+void Reactor::flushRoom() {
+    for (ClientInfo* client : roomDirty) {
+        client->room->dirty = 0;
+        if (sendFrames(client) > 0) {
+            stats.sendCutThrough++;
+        }
+        if (!client->room->queue.empty()) {
+            watch(client, client->epollIn, 1);
+        }
+    }
+    roomDirty.clear();
+}
+
+/* 用一次writev发送队列前部最多ROOM_IOV_MAX个报文，发送完的报文释放引用，返回值同writev */
+ssize_t Reactor::sendFrames(ClientInfo* client) {
+    RoomMember*  member = client->room;
+    struct iovec iov[ROOM_IOV_MAX];
+    int          count  = 0;
+    size_t       offset = member->offset;
+    for (SharedFrame* frame : member->queue) {
+        iov[count].iov_base = frame->data() + offset;
+        iov[count].iov_len  = frame->len - offset;
+        offset              = 0;
+        if (++count == ROOM_IOV_MAX) {
+            break;
+        }
+    }
+    ssize_t n = writev(client->connfd, iov, count);
+    if (n < 0) {
+        if (errno == EWOULDBLOCK) {
+            stats.sendEAGAIN++;
+        }
+        return n;
+    }
+    stats.sendSuccess++;
+    stats.sendBytes += n;
+    member->lag -= n;
+    size_t sent = n;
+    while (sent > 0) {
+        SharedFrame* frame = member->queue.front();
+        size_t       rest  = frame->len - member->offset;
+        if (sent < rest) {
+            member->offset += sent;
+            break;
+        }
+        sent -= rest;
+        member->offset = 0;
+        member->queue.pop_front();
+        releaseFrame(frame);
+    }
+    return n;
+}
+
+void Reactor::releaseFrame(SharedFrame* frame) {
+    if (--frame->refs == 0) {
+        roomBytes -= frame->len;
+        free(frame);
+    }
+}
+
+/* 成员离开：释放发送队列中的引用和接收了一半的报文 */
+void Reactor::leaveRoom(ClientInfo* client) {
+    RoomMember* member = client->room;
+    for (SharedFrame* frame : member->queue) {
+        releaseFrame(frame);
+    }
+    member->queue.clear();
+    if (member->building != nullptr) {
+        releaseFrame(member->building);
+    }
+    memberPool.release(member);
+    client->room = nullptr;
+}
@@ -0,0 +1,324 @@
+#include "Reactor.hpp"
+
+/* io_uring后端：接收使用提供缓冲区环，收到的缓冲区直接挂到对端的发送队列，
+ * 一次把队列中的缓冲区以链接的send提交，发送完成后再归还给内核 */
+
+int Reactor::initUring() {
+    if (uring.init(URING_ENTRIES) < 0) {
+        return -1;
+    }
+    if (bufRing.init(&uring, URING_BUF_COUNT, URING_BUF_SIZE, 0) < 0) {
+        return -1;
+    }
+    bufNext.assign(URING_BUF_COUNT, -1);
+    bufLen.assign(URING_BUF_COUNT, 0);
+    return 0;
+}
+
+void Reactor::runUring() {
+    logInfo(0, logfp, "RelayServer - reactor %d - start (io_uring%s)", index,
+            bufRing.isLegacy() ? ", legacy provided buffers" : "");
+    armDispatch();
+    int deferred = 0;
+    while (true) {
+        /* 提交所有请求并等待至少一个完成事件，有推迟的请求时不等待；完成队列溢出（EBUSY）时先处理已有的完成事件 */
+        if (uring.submit(deferred ? 0 : 1) < 0 && errno != EINTR && errno != EBUSY) {
+            logError(0, logfp, "RelayServer - reactor %d - io_uring_enter error", index);
+            shutdownAll();
+        }
+        struct io_uring_cqe* cqe;
+        int                  ready = 0;
+        while ((cqe = uring.peekCqe()) != nullptr) {
+            handleCompletion(cqe);
+            uring.seenCqe();
+            ready++;
+        }
+        stats.eventsPerWait.observe(ready);
+        deferred = retryDeferred();
+        publishGauges();
+        if (shutFlag && clientNum == 0) {
+            logInfo(0, logfp, "RelayServer - reactor %d - all connected sockets are closed", index);
+            prepareExit();
+            break;
+        }
+    }
+}
+
+void Reactor::armDispatch() {
+    struct io_uring_sqe* sqe = uring.getSqe();
+    dispatchDeferred         = sqe == nullptr;
+    if (sqe == nullptr) {
+        return;
+    }
+    sqe->opcode        = IORING_OP_POLL_ADD;
+    sqe->fd            = dispatchfd[0];
+    sqe->poll32_events = POLLIN;
+    sqe->user_data     = URING_DISPATCH;
+}
+
+/* 提交队列已满时推迟的请求，在处理完一轮完成事件、队列有了空位后重新发起，仍然失败的留到下一轮。
+ * 返回是否还有推迟的请求 */
+int Reactor::retryDeferred() {
+    bufRing.flushDeferred();
+    if (dispatchDeferred) {
+        armDispatch();
+    }
+    std::vector<ClientInfo*> clients;
+    clients.swap(deferredRecv);
+    for (ClientInfo* client : clients) {
+        armRecv(client);
+    }
+    clients.clear();
+    clients.swap(deferredSend);
+    for (ClientInfo* client : clients) {
+        if (!client->closing) {
+            flushSend(client);
+        }
+    }
+    return dispatchDeferred || !deferredRecv.empty() || !deferredSend.empty() || bufRing.hasDeferred();
+}
+
+void Reactor::armRecv(ClientInfo* client) {
+    if (client->recvArmed || client->closing) {
+        return;
+    }
+    struct io_uring_sqe* sqe = uring.getSqe();
+    if (sqe == nullptr) {
+        deferredRecv.push_back(client);
+        return;
+    }
+    sqe->opcode       = IORING_OP_RECV;
+    sqe->fd           = client->connfd;
+    sqe->len          = 0; /* 由所选缓冲区决定 */
+    sqe->flags        = IOSQE_BUFFER_SELECT;
+    sqe->buf_group    = 0;
+    sqe->user_data    = (uint64_t)client | URING_RECV;
+    client->recvArmed = 1;
+    client->inflight++;
+}
+
+void Reactor::flushSend(ClientInfo* client) {
+    if (client->sendInflight > 0 || client->sendHead < 0) {
+        return;
+    }
+    /* 已关闭写的一端，丢弃待发送的数据 */
+    if (client->state == 1) {
+        while (client->sendHead >= 0) {
+            int bid          = client->sendHead;
+            client->sendHead = bufNext[bid];
+            client->sendQueued--;
+            queuedBytes -= bufLen[bid];
+            recycleBuffer(bid);
+        }
+        client->sendTail = -1;
+        return;
+    }
+    /* 按顺序链接提交队列，前一个完成后才开始下一个。先确认提交队列的空位，
+     * 只链接放得下的前一部分，最后一项不带链接标志，不会留下半截链；其余的等这一批发送完成后再提交 */
+    unsigned space = uring.sqSpace();
+    if (space == 0) {
+        deferredSend.push_back(client);
+        return;
+    }
+    for (int bid = client->sendHead; bid >= 0 && space > 0; bid = bufNext[bid], --space) {
+        struct io_uring_sqe* sqe = uring.getSqe();
+        sqe->opcode              = IORING_OP_SEND;
+        sqe->fd                  = client->connfd;
+        sqe->addr                = (uint64_t)bufRing.buffer(bid);
+        sqe->len                 = bufLen[bid];
+        sqe->msg_flags           = MSG_WAITALL | MSG_NOSIGNAL;
+        sqe->user_data           = (uint64_t)client | URING_SEND;
+        if (bufNext[bid] >= 0 && space > 1) {
+            sqe->flags = IOSQE_IO_LINK;
+        }
+        client->sendInflight++;
+        client->inflight++;
+    }
+}
+
+void Reactor::recycleBuffer(int bid) {
+    bufNext[bid] = -1;
+    bufRing.recycle(bid);
+    /* 有缓冲区可用了，恢复因缺少缓冲区而暂停的接收 */
+    while (!starved.empty()) {
+        ClientInfo* client = starved.back();
+        starved.pop_back();
+        armRecv(client);
+    }
+}
+
+void Reactor::consumeFrames(ClientInfo* client, const char* data, size_t n) {
+    while (n > 0) {
+        size_t len = std::min(n, (size_t)client->unrecv);
+        if (client->recvFlag == 0) {
+            memcpy((char*)&client->header + (sizeof(Header) - client->unrecv), data, len);
+        }
+        data += len;
+        n -= len;
+        client->unrecv -= len;
+        if (client->unrecv == 0 && client->recvFlag == 0) {
+            client->unrecv   = handleHeader(&client->header, client);
+            client->recvFlag = 1;
+            stats.recvPackets++;
+        }
+        if (client->unrecv == 0 && client->recvFlag == 1) {
+            client->unrecv   = sizeof(Header);
+            client->recvFlag = 0;
+        }
+    }
+}
+
+void Reactor::handleCompletion(struct io_uring_cqe* cqe) {
+    int         type   = cqe->user_data & URING_OP_MASK;
+    ClientInfo* client = (ClientInfo*)(cqe->user_data & ~URING_OP_MASK);
+    int         res    = cqe->res;
+    /* 归还缓冲区失败（成功时不产生完成事件） */
+    if (type == 0) {
+        errno = -res;
+        logError(-1, logfp, "RelayServer - reactor %d - provide buffers error", index);
+        return;
+    }
+    /* 监听线程分发的新连接 */
+    if (type == URING_DISPATCH) {
+        if (handleDispatch() < 0) {
+            shutdownAll();
+        }
+        armDispatch();
+        return;
+    }
+    client->inflight--;
+    if (type == URING_RECV) {
+        client->recvArmed = 0;
+        int bid           = (cqe->flags & IORING_CQE_F_BUFFER) ? (int)(cqe->flags >> IORING_CQE_BUFFER_SHIFT) : -1;
+        if (client->closing) {
+            if (bid >= 0) {
+                recycleBuffer(bid);
+            }
+        }
+        else if (res > 0) {
+            stats.recvSuccess++;
+            stats.recvBytes += res;
+            stats.recvSize.observe(res);
+            consumeFrames(client, bufRing.buffer(bid), res);
+            ClientInfo* peerC = client->peer;
+            if (peerC != nullptr && !peerC->closing) {
+                bufLen[bid] = res;
+                if (peerC->sendTail >= 0) {
+                    bufNext[peerC->sendTail] = bid;
+                }
+                else {
+                    peerC->sendHead = bid;
+                }
+                peerC->sendTail = bid;
+                peerC->sendQueued++;
+                queuedBytes += res;
+                flushSend(peerC);
+            }
+            else {
+                recycleBuffer(bid); /* 对端不存在，丢弃数据 */
+            }
+            /* 对端积压过多时暂停接收，等对端发送完成后再恢复 */
+            if (peerC == nullptr || peerC->sendQueued < URING_QUEUE_MAX) {
+                armRecv(client);
+            }
+        }
+        else if (res == 0) {
+            stats.recvFINs++;
+            logInfo(0, logfp, "RelayServer - client %u - receive FIN from client (id:%u)", client->cliID, client->id);
+            if (client->state == 0) { /* 之前未关闭连接，则直接关闭写 */
+                shutdown(client->connfd, SHUT_WR);
+            }
+            else {
+                shutdown(client->connfd, SHUT_RD); /* 之前关闭了写，则把读关闭 */
+            }
+            removeUringClient(client);
+        }
+        else if (res == -ENOBUFS) {
+            stats.recvNoSpace++;
+            starved.push_back(client);
+        }
+        else {
+            stats.recvError++;
+            errno = -res;
+            logError(-1, logfp, "RelayServer - client %u - recv error (id:%u)", client->cliID, client->id);
+            removeUringClient(client);
+        }
+    }
+    else if (type == URING_SEND) {
+        int bid          = client->sendHead;
+        client->sendHead = bufNext[bid];
+        if (client->sendHead < 0) {
+            client->sendTail = -1;
+        }
+        client->sendQueued--;
+        client->sendInflight--;
+        uint32_t len = bufLen[bid];
+        queuedBytes -= len;
+        recycleBuffer(bid);
+        if (res > 0) {
+            stats.sendBytes += res;
+        }
+        if (client->closing) {
+            /* 等待其余操作完成 */
+        }
+        else if (res >= 0 && (uint32_t)res == len) {
+            stats.sendSuccess++;
+            flushSend(client);
+            ClientInfo* peerC = client->peer;
+            if (peerC != nullptr && client->sendQueued < URING_QUEUE_MAX) {
+                armRecv(peerC);
+            }
+        }
+        else {
+            stats.sendError++;
+            errno = res < 0 ? -res : EPIPE;
+            logError(-1, logfp, "RelayServer - client %u - send error (id:%u)", client->cliID, client->id);
+            removeUringClient(client);
+        }
+    }
+    if (client->closing && client->inflight == 0) {
+        finalizeUringClient(client);
+    }
+}
+
+/* 断开连接并唤醒挂起的操作，所有操作完成后才真正释放（只在处理完成事件时调用） */
+int Reactor::removeUringClient(ClientInfo* client) {
+    if (client->closing) {
+        return 0;
+    }
+    client->closing = 1;
+    if (client->peer != nullptr) {
+        ClientInfo* peerC = client->peer;
+        peerC->peer       = nullptr;
+        client->peer      = nullptr;
+        sessionNum--;
+        armRecv(peerC); /* 对端可能因积压而暂停了接收 */
+    }
+    shutdown(client->connfd, SHUT_RDWR); /* 让挂起的接收尽快完成，由handleCompletion负责释放 */
+    return 0;
+}
+
+void Reactor::finalizeUringClient(ClientInfo* client) {
+    int      connfd = client->connfd;
+    uint32_t cliID  = client->cliID;
+    uint32_t id     = client->id;
+    while (client->sendHead >= 0) {
+        int bid          = client->sendHead;
+        client->sendHead = bufNext[bid];
+        queuedBytes -= bufLen[bid];
+        recycleBuffer(bid);
+    }
+    starved.erase(std::remove(starved.begin(), starved.end(), client), starved.end());
+    deferredRecv.erase(std::remove(deferredRecv.begin(), deferredRecv.end(), client), deferredRecv.end());
+    deferredSend.erase(std::remove(deferredSend.begin(), deferredSend.end(), client), deferredSend.end());
+    freeSlot(client);
+    clientIDs[localIndex(cliID)] = nullptr;
+    clientFDs[connfd]            = nullptr;
+    clientNum--;
+    if (close(connfd) < 0) {
+        logError(-1, logfp, "RelayServer - client %u - close error", cliID);
+    }
+    allocator->release(cliID);
+    logInfo(0, logfp, "RelayServer - client %u - client left (id:%u) (%zd in reactor %d)", cliID, id, clientNum,
+            index);
+}
@@ -1,4 +1,5 @@
 #include "RelayServer.hpp"
+#include <sys/resource.h>
 #include <vector>
 
 int RelayServer::exitFlag = 0;
@@ -12,6 +13,24 @@ int RelayServer::start(const char* ip, const char* port, int logFlag) {
     else {
         status = 1;
     }
+    if (config.threads <= 0) {
+        printf("The number of threads must be positive\n");
+        return -1;
+    }
+    if (config.room < 0 || config.room == 1) {
+        printf("The room size must be 0 (paired sessions) or at least 2\n");
+        return -1;
+    }
+    if (config.prealloc < 0) {
+        printf("The number of preallocated connections must not be negative\n");
+        return -1;
+    }
+    /* 每个会话占用两个描述符，把描述符数量的软限制提高到硬限制 */
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
     /* 确定log文件 */
     if (logFlag) {
         logfp = fopen(logFilename, "w");
@@ -29,7 +48,12 @@ int RelayServer::start(const char* ip, const char* port, int logFlag) {
     logInfo(0, logfp, "RelayServer - server - server shutdowns");
     printf("Server shutdowns\n");
     printStatistics();
+    for (Reactor* reactor : reactors) {
+        delete reactor;
+    }
+    reactors.clear();
     if (logfp != nullptr) {
+        logFlush(logfp);
         fclose(logfp);
         logfp = nullptr;
     }
@@ -38,34 +62,90 @@ int RelayServer::start(const char* ip, const char* port, int logFlag) {
 }
 
 void RelayServer::printStatistics() {
+    Statistics total;
+    for (size_t i = 0; i < reactors.size(); ++i) {
+        const Statistics& stats = reactors[i]->statistics();
+        logInfo(0, logfp, "RelayServer - reactor %zd - recvBytes: %lu, sendBytes: %lu", i, stats.recvBytes.load(),
+                stats.sendBytes.load());
+        addStatistics(&total, &stats);
+    }
+    /* 转发每GB数据消耗的CPU时间（秒） */
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    double cpuTime  = usage.ru_utime.tv_sec + usage.ru_stime.tv_sec
+                      + (double)(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000000;
+    double cpuPerGB = total.sendBytes > 0 ? cpuTime / ((double)total.sendBytes / (1 << 30)) : 0;
     logInfo(0, logfp, "RelayServer - server - Statistics:");
-    logInfo(0, logfp, "RelayServer - server - usrBufferSize: %d", BUFFER_SIZE);
-    logInfo(0, logfp, "RelayServer - server - recvBytes: %lu", s_recvBytes);
-    logInfo(0, logfp, "RelayServer - server - recvPackets: %lu", s_recvPackets);
-    logInfo(0, logfp, "RelayServer - server - recvFINs: %lu", s_recvFINs);
-    logInfo(0, logfp, "RelayServer - server - recvNoSpace: %lu", s_recvNoSpace);
-    logInfo(0, logfp, "RelayServer - server - recvSuccess: %lu", s_recvSuccess);
-    logInfo(0, logfp, "RelayServer - server - recvEAGAIN: %lu", s_recvEAGAIN);
-    logInfo(0, logfp, "RelayServer - server - recvError: %lu", s_recvError);
-    logInfo(0, logfp, "RelayServer - server - sendBytes: %lu", s_sendBytes);
-    logInfo(0, logfp, "RelayServer - server - sendNoData: %lu", s_sendNoData);
-    logInfo(0, logfp, "RelayServer - server - sendSuccess: %lu", s_sendSuccess);
-    logInfo(0, logfp, "RelayServer - server - sendEAGAIN: %lu", s_sendEAGAIN);
-    logInfo(0, logfp, "RelayServer - server - sendError: %lu", s_sendError);
+    logInfo(0, logfp, "RelayServer - server - threads: %d", config.threads);
+    logInfo(0, logfp, "RelayServer - server - relayMode: %s", config.relayMode == RELAY_SPLICE ? "splice" : "copy");
+    logInfo(0, logfp, "RelayServer - server - backend: %s", acceptBackend == BACKEND_URING ? "io_uring" : "epoll");
+    logInfo(0, logfp, "RelayServer - server - epollMode: %s", config.epollMode == EPOLL_ET ? "et" : "lt");
+    logInfo(0, logfp, "RelayServer - server - cpuTime: %lf", cpuTime);
+    logInfo(0, logfp, "RelayServer - server - cpuPerGB: %lf", cpuPerGB);
+    logInfo(0, logfp, "RelayServer - server - usrBufferSize: %zd-%zd", BufferPool::tierSize(0),
+            BufferPool::tierSize(BUFFER_TIERS - 1));
+    logInfo(0, logfp, "RelayServer - server - bufferPeak: %lu", total.bufferPeak.load());
+    logInfo(0, logfp, "RelayServer - server - recvBytes: %lu", total.recvBytes.load());
+    logInfo(0, logfp, "RelayServer - server - recvPackets: %lu", total.recvPackets.load());
+    logInfo(0, logfp, "RelayServer - server - recvFINs: %lu", total.recvFINs.load());
+    logInfo(0, logfp, "RelayServer - server - recvNoSpace: %lu", total.recvNoSpace.load());
+    logInfo(0, logfp, "RelayServer - server - recvSuccess: %lu", total.recvSuccess.load());
+    logInfo(0, logfp, "RelayServer - server - recvEAGAIN: %lu", total.recvEAGAIN.load());
+    logInfo(0, logfp, "RelayServer - server - recvError: %lu", total.recvError.load());
+    logInfo(0, logfp, "RelayServer - server - sendBytes: %lu", total.sendBytes.load());
+    logInfo(0, logfp, "RelayServer - server - sendNoData: %lu", total.sendNoData.load());
+    logInfo(0, logfp, "RelayServer - server - sendSuccess: %lu", total.sendSuccess.load());
+    logInfo(0, logfp, "RelayServer - server - sendEAGAIN: %lu", total.sendEAGAIN.load());
+    logInfo(0, logfp, "RelayServer - server - sendError: %lu", total.sendError.load());
+    logInfo(0, logfp, "RelayServer - server - sendCutThrough: %lu", total.sendCutThrough.load());
+    logInfo(0, logfp, "RelayServer - server - poolHits: %lu", total.poolHits.load());
+    logInfo(0, logfp, "RelayServer - server - poolMisses: %lu", total.poolMisses.load());
+    logInfo(0, logfp, "RelayServer - server - allocFailures: %lu", total.allocFailures.load());
+    logInfo(0, logfp, "RelayServer - server - offlineBytes: %lu", total.offlineBytes.load());
+    logInfo(0, logfp, "RelayServer - server - replayBytes: %lu", total.replayBytes.load());
+    logInfo(0, logfp, "RelayServer - server - offlineSpilled: %lu", total.offlineSpilled.load());
+    logInfo(0, logfp, "RelayServer - server - offlineDropped: %lu", total.offlineDropped.load());
+    logInfo(0, logfp, "RelayServer - server - roomFrames: %lu", total.roomFrames.load());
+    logInfo(0, logfp, "RelayServer - server - roomDropped: %lu", total.roomDropped.load());
+    logInfo(0, logfp, "RelayServer - server - pauseWatermark: %lu", total.pauseWatermark.load());
+    logInfo(0, logfp, "RelayServer - server - pauseBudget: %lu", total.pauseBudget.load());
     printf("Server statistics:\n\n");
-    printf("usrBufferSize: %d\n\n", BUFFER_SIZE);
-    printf("recvBytes: %lu\n", s_recvBytes);
-    printf("recvPackets: %lu\n", s_recvPackets);
-    printf("recvFINs: %lu\n", s_recvFINs);
-    printf("recvNoSpace: %lu\n", s_recvNoSpace);
-    printf("recvSuccess: %lu\n", s_recvSuccess);
-    printf("recvEAGAIN: %lu\n", s_recvEAGAIN);
-    printf("recvError: %lu\n\n", s_recvError);
-    printf("sendBytes: %lu\n", s_sendBytes);
-    printf("sendNoData: %lu\n", s_sendNoData);
-    printf("sendSuccess: %lu\n", s_sendSuccess);
-    printf("sendEAGAIN: %lu\n", s_sendEAGAIN);
-    printf("sendError: %lu\n", s_sendError);
+    printf("threads: %d\n", config.threads);
+    printf("relayMode: %s\n", config.relayMode == RELAY_SPLICE ? "splice" : "copy");
+    printf("backend: %s\n", acceptBackend == BACKEND_URING ? "io_uring" : "epoll");
+    printf("epollMode: %s\n", config.epollMode == EPOLL_ET ? "et" : "lt");
+    printf("cpuTime: %lf\n", cpuTime);
+    printf("cpuPerGB: %lf\n", cpuPerGB);
+    printf("usrBufferSize: %zd-%zd\n", BufferPool::tierSize(0), BufferPool::tierSize(BUFFER_TIERS - 1));
+    printf("bufferPeak: %lu\n\n", total.bufferPeak.load());
+    printf("recvBytes: %lu\n", total.recvBytes.load());
+    printf("recvPackets: %lu\n", total.recvPackets.load());
+    printf("recvFINs: %lu\n", total.recvFINs.load());
+    printf("recvNoSpace: %lu\n", total.recvNoSpace.load());
+    printf("recvSuccess: %lu\n", total.recvSuccess.load());
+    printf("recvEAGAIN: %lu\n", total.recvEAGAIN.load());
+    printf("recvError: %lu\n\n", total.recvError.load());
+    printf("sendBytes: %lu\n", total.sendBytes.load());
+    printf("sendNoData: %lu\n", total.sendNoData.load());
+    printf("sendSuccess: %lu\n", total.sendSuccess.load());
+    printf("sendEAGAIN: %lu\n", total.sendEAGAIN.load());
+    printf("sendError: %lu\n", total.sendError.load());
+    printf("sendCutThrough: %lu\n\n", total.sendCutThrough.load());
+    printf("poolHits: %lu\n", total.poolHits.load());
+    printf("poolMisses: %lu\n", total.poolMisses.load());
+    printf("allocFailures: %lu\n", total.allocFailures.load());
+    printf("pauseWatermark: %lu\n", total.pauseWatermark.load());
+    printf("pauseBudget: %lu\n", total.pauseBudget.load());
+    if (config.offline != nullptr || config.offlineMemory > 0) {
+        printf("offlineBytes: %lu\n", total.offlineBytes.load());
+        printf("replayBytes: %lu\n", total.replayBytes.load());
+        printf("offlineSpilled: %lu\n", total.offlineSpilled.load());
+        printf("offlineDropped: %lu\n", total.offlineDropped.load());
+    }
+    if (config.room > 0) {
+        printf("roomFrames: %lu\n", total.roomFrames.load());
+        printf("roomDropped: %lu\n", total.roomDropped.load());
+    }
 }
 
 /* 返回值：-1表示出现错误终止，0表示被SIGINT信号终止 */
@@ -99,400 +179,191 @@ int RelayServer::doit(const char* ip, const char* port) {
     logInfo(0, logfp, "RelayServer - server - bind to %s:%s", ip, port);
 
     /* 创建epoll事件表描述符 */
-    struct epoll_event events[MAX_EVENT_NUMBER];
+    struct epoll_event events[1];
     epollfd = epoll_create(1);
     assert(epollfd >= 0);
 
-    /* 开始监听 */
-    if (toListen(listenfd, BACKLOG, logfp) < 0) {
+    /* 启动Reactor线程 */
+    if (startReactors() < 0) {
         close(listenfd);
+        close(epollfd);
         return -1;
     }
-    logInfo(0, logfp, "RelayServer - server - begin to listen", ip, port);
 
-    /* 添加监听套接字到epoll事件表 */
-    addfd(epollfd, listenfd, 0, 0);
-    setnonblocking(listenfd);
-
-    while (true) {
-        /* 等待事件 */
-        int ready = epoll_wait(epollfd, events, MAX_EVENT_NUMBER, -1);
-        if (ready < 0) {
-            logError(0, logfp, "RelayServer - server - epoll_wait error");
-            shutdownAll();
-        }
-        /* 处理事件 */
-        if (handleEvents(events, ready) < 0) {
-            shutdownAll();
+    /* 开始监听，指定了指标端口时同时启动指标线程 */
+    if (toListen(listenfd, BACKLOG, logfp) < 0 || (config.metrics != nullptr && metrics.start(ip, config.metrics, logfp) < 0)) {
+        close(listenfd);
+        listenfd = -1;
+        shutdownAll();
+    }
+    else {
+        logInfo(0, logfp, "RelayServer - server - begin to listen", ip, port);
+        /* 优先使用io_uring的multishot accept，不可用时退回epoll */
+        if (config.backend == BACKEND_URING && uring.init(URING_ACCEPT_ENTRIES) == 0) {
+            acceptBackend = BACKEND_URING;
+            armAccept();
         }
-        if (exitFlag || shutFlag) {
-            shutdownAll();
-            if (clientFDs.size() == 0) {
-                logInfo(0, logfp, "RelayServer - server - all connected sockets are closed");
-                prepareExit();
-                break;
+        else {
+            if (config.backend == BACKEND_URING) {
+                logError(-1, logfp, "RelayServer - server - io_uring unavailable, fall back to epoll");
             }
+            /* 添加监听套接字到epoll事件表 */
+            addfd(epollfd, listenfd, 0, 0);
+            setnonblocking(listenfd);
         }
     }
 
-    return 0;
-}
-
-int RelayServer::handleEvents(struct epoll_event* events, const int& number) {
-    for (int i = 0; i < number; ++i) {
-        int sockfd = events[i].data.fd;
-        /* 监听套接字 */
-        if (sockfd == listenfd) {
-            while (true) {
-                int connfd = accept(listenfd, NULL, NULL);
-                if (connfd < 0) {
-                    if (errno == EWOULDBLOCK || errno == ECONNABORTED || errno == EPROTO || errno == EINTR)
-                        break;
-                    else
-                        return logError(-1, logfp, "RelayServer - server - accept error");
-                }
-                ClientInfo* client = new ClientInfo;
-                client->connfd     = connfd;
-                setnonblocking(connfd);
-                addClient(client);
-            }
-        }
-        /* 已连接套接字 */
-        else {
-            /* 初始检查与设置 */
-            assert(clientFDs.find(sockfd) != clientFDs.end());
-            int         selfID = clientFDs[sockfd]->cliID;
-            ClientInfo* selfC  = clientIDs[selfID];
-            assert(clientIDs.find(selfID) != clientIDs.end());
-            int         peerID = counterPart(selfID);
-            ClientInfo* peerC  = nullptr;
-            if (clientIDs.find(peerID) != clientIDs.end()) {
-                peerC = clientIDs[peerID];
-                assert(clientFDs.find(peerC->connfd) != clientFDs.end());
+    while (shutFlag == 0) {
+        if (acceptBackend == BACKEND_URING) {
+            /* 等待accept完成，被SIGINT打断时返回EINTR；accept被推迟时不等待，处理完已有的完成事件后重新提交 */
+            if (uring.submit(acceptDeferred ? 0 : 1) < 0 && errno != EINTR && errno != EBUSY) {
+                logError(0, logfp, "RelayServer - server - io_uring_enter error");
+                shutdownAll();
             }
-            if (peerC == nullptr) {
-                selfC->recved = 0;
-                if (BETTER_EPOLL && selfC->epollIn == 0) {
-                    modfd(epollfd, selfC->connfd, 1, selfC->epollOut);
-                    selfC->epollIn = 1;
-                }
+            else if (handleAccepts() < 0) {
+                shutdownAll();
             }
-            /* 有数据可读，并且有空间可存 */
-            if (events[i].events & EPOLLIN) {
-                // 如果没有空间接收数据
-                if (BUFFER_SIZE == selfC->recved) {
-                    s_recvNoSpace++;
-                }
-                // 如果有空间可接收数据
-                else {
-                    ssize_t n = recv(sockfd, selfC->usrBuf + selfC->recved, BUFFER_SIZE - selfC->recved, 0);
-                    if (n > 0) {
-                        s_recvSuccess++;
-                        s_recvBytes += n;
-                        while (true) {
-                            /* 报头或载荷接收完毕 */
-                            if ((size_t)n >= selfC->unrecv) {
-                                // 处理报头
-                                if (selfC->recvFlag == 0) {
-                                    memcpy((char*)&selfC->header + (sizeof(Header) - selfC->unrecv),
-                                           selfC->usrBuf + selfC->recved, selfC->unrecv);
-                                    size_t msgLen = (size_t)handleHeader(&selfC->header, selfID);
-                                    s_recvPackets++;
-                                    n               = n - selfC->unrecv;
-                                    selfC->recved   = selfC->recved + selfC->unrecv;
-                                    selfC->recvFlag = 1;
-                                    selfC->unrecv   = msgLen;
-                                }
-                                // 处理载荷
-                                else {
-                                    if (peerC == nullptr && SAVE_FILE) {
-                                        writeMsgToFile(peerID, selfC->usrBuf + selfC->recved,
-                                                       selfC->unrecv - 1); /* 不能把/0写进文件 */
-                                        writeMsgToFile(peerID, "\n", 1);
-                                    }
-                                    n               = n - selfC->unrecv;
-                                    selfC->recved   = selfC->recved + selfC->unrecv;
-                                    selfC->recvFlag = 0;
-                                    selfC->unrecv   = sizeof(Header);
-                                }
-                            }
-                            /* 只接受了一部分 */
-                            else {
-                                if (selfC->recvFlag == 0) {
-                                    memcpy((char*)&selfC->header + (sizeof(Header) - selfC->unrecv),
-                                           selfC->usrBuf + selfC->recved, n);
-                                }
-                                else if (selfC->recvFlag == 1 && peerC == nullptr && SAVE_FILE) {
-                                    writeMsgToFile(peerID, selfC->usrBuf + selfC->recved, n);
-                                }
-                                selfC->unrecv = selfC->unrecv - n;
-                                selfC->recved = selfC->recved + n;
-                                break;
-                            }
-                        }
-                    }
-                    else if (n == 0) {
-                        s_recvFINs++;
-                        logInfo(0, logfp, "RelayServer - client %d - receive FIN from client (id:%u)", selfID,
-                                selfC->id);
-                        if (selfC->state == 0) { /* 之前未关闭连接，则直接关闭写 */
-                            shutdown(sockfd, SHUT_WR);
-                        }
-                        else {
-                            shutdown(sockfd, SHUT_RD); /* 之前关闭了写，则把读关闭 */
-                        }
-                        /* 直接关闭写的一端，不再写了，因为数据可能源源不断地来，我们不知道还得写多少
-                         */
-                        removeClient(sockfd);
-                        continue; /* continue最外层的for */
-                    }
-                    else {
-                        if (errno != EWOULDBLOCK) { /* 连接已经结束，直接close套接字 */
-                            s_recvError++;
-                            logError(-1, logfp, "RelayServer - client %d - recv error (id:%u)", selfID, selfC->id);
-                            removeClient(sockfd);
-                            continue; /* continue最外层的for */
-                        }
-                        else {
-                            s_recvEAGAIN++;
-                        }
-                    }
-                    if (peerC == nullptr) {
-                        selfC->recved = 0;
-                    }
-                }
-                // TEST
-                if (BETTER_EPOLL) {
-                    if (selfC->recved == BUFFER_SIZE) {
-                        modfd(epollfd, selfC->connfd, 0, selfC->epollOut);
-                        selfC->epollIn = 0;
-                    }
-                    if (peerC != nullptr && peerC->epollOut == 0 && selfC->recved > 0) {
-                        modfd(epollfd, peerC->connfd, peerC->epollIn, 1);
-                        peerC->epollOut = 1;
-                    }
-                }
+            else if (acceptDeferred) {
+                armAccept();
             }
-            int isExist = 0;
-            if (SAVE_FILE) {
-                isExist = copySavedMsg(selfC);
-                if (selfC->fakePeer != nullptr) {
-                    peerC = selfC->fakePeer;
-                    if (selfC->epollOut == 0 && peerC->recved > 0) {
-                        modfd(epollfd, selfC->connfd, selfC->epollIn, 1);
-                        selfC->epollOut = 1;
-                    }
-                }
+        }
+        else {
+            /* 等待事件 */
+            int ready = epoll_wait(epollfd, events, 1, -1);
+            if (ready < 0 && errno != EINTR) { /* SIGINT由下面的exitFlag处理，其他信号（如SIGPROF）不应导致关闭 */
+                logError(0, logfp, "RelayServer - server - epoll_wait error");
+                shutdownAll();
             }
-            /* 有数据需要发送，并且能够发送，并且未关闭写 */
-            if ((events[i].events & EPOLLOUT) && selfC->state != 1) {
-                if (peerC != nullptr) {
-                    // 无数据可发送
-                    if (peerC->recved == 0) {
-                        s_sendNoData++;
-                    }
-                    // 有数据可发送
-                    else {
-                        ssize_t n = send(sockfd, peerC->usrBuf, peerC->recved, 0);
-                        if (n >= 0) {
-                            s_sendSuccess++;
-                            s_sendBytes += n;
-                            memcpy(peerC->usrBuf, peerC->usrBuf + n, peerC->recved - n);
-                            peerC->recved = peerC->recved - n;
-                        }
-                        else {
-                            if (errno != EWOULDBLOCK) { /* 连接已经结束，直接close套接字 */
-                                s_sendError++;
-                                logError(-1, logfp, "RelayServer - client %d - send error (id:%u)", selfID, selfC->id);
-                                removeClient(sockfd);
-                                continue; /* continue最外层的for */
-                            }
-                            else {
-                                s_sendEAGAIN++;
-                            }
-                        }
-                    }
-                }
-                if (SAVE_FILE) {
-                    // 既没有匹配客户端的数据可发，也没有文件的数据可发
-                    if (selfC->fakePeer != nullptr && selfC->fakePeer->recved == 0 && !isExist) {
-                        delete selfC->fakePeer;
-                        selfC->fakePeer = nullptr;
-                        peerC           = nullptr;
-                    }
-                }
-                if (BETTER_EPOLL) {
-                    // 如果有匹配的客户端
-                    if (selfC->fakePeer == nullptr && peerC != nullptr) {
-                        // 可以接收新数据
-                        if (peerC->recved < BUFFER_SIZE && peerC->epollIn == 0) {
-                            modfd(epollfd, peerC->connfd, 1, peerC->epollOut);
-                            peerC->epollIn = 1;
-                        }
-                        // 没有数据可发
-                        if (peerC->recved == 0 && selfC->epollOut == 1) {
-                            modfd(epollfd, selfC->connfd, selfC->epollIn, 0);
-                            selfC->epollOut = 0;
-                        }
-                    }
-                }
+            /* 接收新连接 */
+            else if (ready > 0 && acceptClients() < 0) {
+                shutdownAll();
             }
         }
+        if (exitFlag) {
+            shutdownAll();
+        }
+    }
+
+    /* 等待所有Reactor关闭连接 */
+    for (Reactor* reactor : reactors) {
+        reactor->join();
     }
+    metrics.stop();
+    close(epollfd);
+    logInfo(0, logfp, "RelayServer - server - all connected sockets are closed");
     return 0;
 }
 
-void RelayServer::shutdownAll() {
-    if (exitFlag && logFlag) {
-        logInfo(0, logfp, "RelayServer - server - received SIGINT signal");
-        logFlag = 0;
-    }
-    if (shutFlag == 0) {
-        close(listenfd);
-        delfd(epollfd, listenfd);
-        logInfo(0, logfp, "RelayServer - server - send FIN to all clients and stop listening");
+int RelayServer::startReactors() {
+    /* Reactor线程屏蔽SIGINT，由主线程处理 */
+    sigset_t mask, oldMask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGINT);
+    pthread_sigmask(SIG_BLOCK, &mask, &oldMask);
+    int r = 0;
+    for (int i = 0; i < config.threads; ++i) {
+        Reactor* reactor = new Reactor(i, &config, &allocator, logfp);
+        reactors.push_back(reactor);
+        if (reactor->start() < 0) {
+            r = -1;
+            break;
+        }
     }
-    shutFlag = 1;
-    for (auto const& cli : clientFDs) {
-        if (cli.second->state == 0) {
-            shutdown(cli.first, SHUT_WR);
-            cli.second->state = 1;
+    pthread_sigmask(SIG_SETMASK, &oldMask, NULL);
+    if (r < 0) {
+        for (Reactor* reactor : reactors) {
+            reactor->stop();
+            reactor->join();
         }
     }
+    logInfo(0, logfp, "RelayServer - server - %zd reactor threads started", reactors.size());
+    return r;
 }
 
-int RelayServer::addClient(ClientInfo* client) {
-    client->cliID = nextID;
-    assert(clientIDs.find(client->cliID) == clientIDs.end() && clientFDs.find(client->connfd) == clientFDs.end());
-    clientIDs[client->cliID]  = client;
-    clientFDs[client->connfd] = client;
-    updateNextID();
-    if (BETTER_EPOLL) {
-        addfd(epollfd, client->connfd, 0, 0);
-    }
-    else {
-        addfd(epollfd, client->connfd, 1, 0); /* 使用EPOLLIN | EPOLLOUT，启用LT模式 */
+int RelayServer::acceptClients() {
+    while (true) {
+        int connfd = accept(listenfd, NULL, NULL);
+        if (connfd < 0) {
+            if (errno == EWOULDBLOCK || errno == ECONNABORTED || errno == EPROTO || errno == EINTR)
+                break;
+            else
+                return logError(-1, logfp, "RelayServer - server - accept error");
+        }
+        dispatchClient(connfd);
     }
-    logInfo(0, logfp, "RelayServer - client %d - new client (%zd in total)", client->cliID, clientFDs.size());
     return 0;
 }
 
-int RelayServer::removeClient(const int& connfd) {
-    assert(clientFDs.find(connfd) != clientFDs.end());
-    int      cliID = clientFDs[connfd]->cliID;
-    uint32_t id    = clientFDs[connfd]->id;
-    delete clientFDs[connfd];
-    clientIDs.erase(cliID);
-    clientFDs.erase(connfd);
-    if (cliID < nextID) {
-        nextID = cliID;
-    }
-    if (close(connfd) < 0) {
-        logError(-1, logfp, "RelayServer - client %d - close error", cliID);
+void RelayServer::armAccept() {
+    struct io_uring_sqe* sqe = uring.getSqe();
+    acceptDeferred           = sqe == nullptr;
+    if (sqe == nullptr) {
+        return;
     }
-    delfd(epollfd, connfd);
-    logInfo(0, logfp, "RelayServer - client %d - client left (id:%u) (%zd in total)", cliID, id, clientFDs.size());
-    return 0;
+    sqe->opcode    = IORING_OP_ACCEPT;
+    sqe->fd        = listenfd;
+    sqe->ioprio    = IORING_ACCEPT_MULTISHOT; /* 一次提交，每个新连接产生一个完成事件 */
+    sqe->user_data = URING_ACCEPT;
 }
 
-void RelayServer::updateNextID() {
-    for (int id = nextID;; ++id) {
-        if (clientIDs.find(id) == clientIDs.end()) {
-            nextID = id;
-            break;
+int RelayServer::handleAccepts() {
+    struct io_uring_cqe* cqe;
+    while ((cqe = uring.peekCqe()) != nullptr) {
+        int res  = cqe->res;
+        int more = cqe->flags & IORING_CQE_F_MORE;
+        uring.seenCqe();
+        if (res >= 0) {
+            dispatchClient(res);
+        }
+        else if (res != -ECONNABORTED && res != -EPROTO && res != -EINTR) {
+            errno = -res;
+            return logError(-1, logfp, "RelayServer - server - accept error");
+        }
+        /* 内核结束了multishot accept，需要重新提交 */
+        if (!more) {
+            armAccept();
         }
     }
+    return 0;
 }
 
-int RelayServer::writeMsgToFile(const int& id, const void* buf, const size_t& size) {
-    char filename[NAME_MAX];
-    sprintf(filename, "MESSAGE_TO_%d.txt", id);
-    FILE* fp = nullptr;
-    if (msgAppend.find(id) != msgAppend.end()) {
-        fp = msgAppend[id].fp;
+void RelayServer::dispatchClient(int connfd) {
+    int64_t cliID = allocator.acquire();
+    if (cliID < 0) {
+        logInfo(0, logfp, "RelayServer - server - no client ID available, refuse connection");
+        close(connfd);
+        return;
     }
-    else {
-        fp = fopen(filename, "a");
-        File file;
-        file.fp = fp;
-        strcpy(file.filename, filename);
-        msgAppend[id] = file;
+    setnonblocking(connfd);
+    if (placeClient(cliID)->dispatch(connfd, cliID) < 0) {
+        allocator.release(cliID);
+        close(connfd);
     }
-    fwrite(buf, size, 1, fp);
-    fflush(fp);
-    return 0;
 }
 
-int RelayServer::copySavedMsg(ClientInfo* selfC) {
-    FILE* fp = nullptr;
-    char  filename[NAME_MAX];
-    sprintf(filename, "MESSAGE_TO_%d.txt", selfC->cliID);
-    if (msgRead.find(selfC->cliID) != msgRead.end()) {
-        assert(msgRead[selfC->cliID].fp != nullptr);
-        fp = msgRead[selfC->cliID].fp;
-    }
-    else {
-        if (access(filename, F_OK) == 0) {
-            fp = fopen(filename, "r");
-            File file;
-            file.fp = fp;
-            strcpy(file.filename, filename);
-            msgRead[selfC->cliID] = file;
-        }
-        else { /* 没有信息文件 */
-            return 0;
-        }
-    }
-    assert(fp != nullptr);
-    if (selfC->fakePeer == nullptr) {
-        selfC->fakePeer         = new ClientInfo;
-        selfC->fakePeer->recved = 0;
+/* 同一会话的两个客户端或同一房间的所有成员放到同一个Reactor，保证转发路径无锁 */
+Reactor* RelayServer::placeClient(uint32_t cliID) {
+    return reactors[(cliID / groupSize(config)) % reactors.size()];
+}
+
+void RelayServer::shutdownAll() {
+    if (exitFlag && logFlag) {
+        logInfo(0, logfp, "RelayServer - server - received SIGINT signal");
+        logFlag = 0;
     }
-    ClientInfo* peerC = selfC->fakePeer;
-    while (true) {
-        ssize_t msgWindow = BUFFER_SIZE - (ssize_t)peerC->recved - (ssize_t)sizeof(Header);
-        if (msgWindow > 0) {
-            char* msgPtr = peerC->usrBuf + peerC->recved + sizeof(Header);
-            if (fgets(msgPtr, msgWindow, fp) != nullptr) {
-                if (!(feof(fp) && *msgPtr == '\n')) { /* 没有到文件末尾 */
-                    size_t msgLen = strlen(msgPtr);
-                    if (*(msgPtr + msgLen - 1) == '\n') {
-                        *(msgPtr + msgLen - 1) = '\0';
-                    }
-                    else {
-                        msgLen = msgLen + 1; /* 将\0包含进去 */
-                    }
-                    Header          header;
-                    struct timespec timestamp = getHeader(msgLen, 0, &header);
-                    memcpy(peerC->usrBuf + peerC->recved, &header, sizeof(Header));
-                    peerC->recved = peerC->recved + sizeof(Header) + msgLen;
-                    logInfo(0, logfp,
-                            "RelayServer - client %d - packet from file %s: <length: "
-                            "%hd, id: %d, time: %s>",
-                            selfC->cliID, filename, msgLen, 0, strftTime(&timestamp).c_str());
-                }
-            }
-            if (feof(fp)) {
-                fclose(fp);
-                msgRead.erase(selfC->cliID);
-                if (msgAppend.find(selfC->cliID) != msgAppend.end()) {
-                    fclose(msgAppend[selfC->cliID].fp);
-                    msgAppend.erase(selfC->cliID);
-                }
-                if (remove(filename) < 0) {
-                    return logError(0, logfp, "RelayServer - client %d - fail to remove file %s", selfC->cliID,
-                                    filename);
-                }
-                else {
-                    return logInfo(0, logfp, "RelayServer - client %d - remove file %s", selfC->cliID, filename);
-                }
+    if (shutFlag == 0) {
+        if (listenfd >= 0) {
+            if (acceptBackend == BACKEND_EPOLL) {
+                delfd(epollfd, listenfd);
             }
+            close(listenfd);
         }
-        else {
-            break;
+        for (Reactor* reactor : reactors) {
+            reactor->stop();
         }
+        logInfo(0, logfp, "RelayServer - server - send FIN to all clients and stop listening");
     }
-    return 1;
+    shutFlag = 1;
 }
 
 void RelayServer::sigIntHandler(int signum) {
@@ -517,28 +388,3 @@ sigfunc* RelayServer::signal(int signo, sigfunc* func) {
 
     return (oact.sa_handler);
 }
-
-uint16_t RelayServer::handleHeader(struct Header* header, const uint16_t& cliID) {
-    uint16_t msgLen      = ntohs(header->length);
-    clientIDs[cliID]->id = ntohl(header->id);
-    if (logfp == nullptr)
-        return msgLen;
-    // struct timespec timestamp;
-    // timestamp.tv_sec  = ntoh64(header->sec);
-    // timestamp.tv_nsec = ntoh64(header->nsec);
-    // logInfo(0, logfp, "RelayServer - client %d - recv header: <length: %hd, id:
-    // %d, time: %s>", cliID, msgLen,
-    //         ntohl(header->id), strftTime(&timestamp).c_str());
-    return msgLen;
-}
-
-void RelayServer::prepareExit() {
-    for (auto file : msgRead) {
-        fclose(file.second.fp);
-        if (msgAppend.find(file.first) != msgAppend.end()) {
-            fclose(msgAppend[file.first].fp);
-        }
-        remove(file.second.filename);
-    }
-    logInfo(0, logfp, "RelayServer - server - all read files are deleted");
-}
\ No newline at end of file
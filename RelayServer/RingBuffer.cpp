@@ -0,0 +1,95 @@
+#include "RingBuffer.hpp"
+
+void RingBuffer::attach(char* storage, size_t capacity) {
+    assert(capacity > 0 && (capacity & (capacity - 1)) == 0);
+    this->data = storage;
+    this->cap  = capacity;
+    this->mask = capacity - 1;
+    this->head = 0;
+    this->tail = 0;
+}
+
+char* RingBuffer::detach() {
+    char* storage = data;
+    data          = nullptr;
+    cap = mask = 0;
+    head = tail = 0;
+    return storage;
+}
+
+char* RingBuffer::migrate(char* storage, size_t capacity) {
+    size_t len = size();
+    assert(capacity >= len);
+    copyOut(head, storage, len);
+    char* old = data;
+    attach(storage, capacity);
+    tail = len;
+    return old;
+}
+
+int RingBuffer::regions(uint64_t pos, size_t len, struct iovec* iov) const {
+    if (len == 0) {
+        return 0;
+    }
+    size_t offset = pos & mask;
+    size_t first  = cap - offset;
+
+    iov[0].iov_base = data + offset;
+    if (len <= first) {
+        iov[0].iov_len = len;
+        return 1;
+    }
+    iov[0].iov_len  = first;
+    iov[1].iov_base = data;
+    iov[1].iov_len  = len - first;
+    return 2;
+}
+
+int RingBuffer::freeRegions(struct iovec* iov) const {
+    return regions(tail, space(), iov);
+}
+
+void RingBuffer::copyOut(uint64_t pos, void* dst, size_t len) const {
+    struct iovec iov[2];
+    int          cnt = regions(pos, len, iov);
+    for (int i = 0; i < cnt; ++i) {
+        memcpy(dst, iov[i].iov_base, iov[i].iov_len);
+        dst = (char*)dst + iov[i].iov_len;
+    }
+}
+
+int RingBuffer::append(const void* src, size_t len) {
+    if (len > space()) {
+        return -1;
+    }
+    struct iovec iov[2];
+    int          cnt = regions(tail, len, iov);
+    for (int i = 0; i < cnt; ++i) {
+        memcpy(iov[i].iov_base, src, iov[i].iov_len);
+        src = (const char*)src + iov[i].iov_len;
+    }
+    tail += len;
+    return 0;
+}
+
+ssize_t RingBuffer::recvFrom(int fd) {
+    struct iovec iov[2];
+    int          cnt = freeRegions(iov);
+    assert(cnt > 0);
+    ssize_t n = readv(fd, iov, cnt);
+    if (n > 0) {
+        tail += n;
+    }
+    return n;
+}
+
+ssize_t RingBuffer::sendTo(int fd) {
+    struct iovec iov[2];
+    int          cnt = regions(head, size(), iov);
+    assert(cnt > 0);
+    ssize_t n = writev(fd, iov, cnt);
+    if (n > 0) {
+        head += n;
+    }
+    return n;
+}
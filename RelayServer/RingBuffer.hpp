@@ -0,0 +1,90 @@
+#pragma once
+
+#include "../common/common.hpp"
+#include <sys/uio.h>
+
+/* 容量为2的幂的环形缓冲区。读写位置单调递增，取模得到下标；
+ * 收发时用readv/writev跨越回绕点，数据在用户空间内只在换用更大的存储空间时移动一次。
+ * 存储空间可以随时摘下，没有存储空间时容量为0 */
+class RingBuffer {
+private:
+    char*    data = nullptr; /* 存储空间（不属于本对象） */
+    size_t   cap  = 0;       /* 容量，必须是2的幂 */
+    size_t   mask = 0;       /* cap - 1 */
+    uint64_t head = 0;       /* 读位置 */
+    uint64_t tail = 0;       /* 写位置 */
+
+public:
+    /* 使用storage作为存储空间，capacity必须是2的幂 */
+    void attach(char* storage, size_t capacity);
+
+    /* 摘下并返回存储空间，缓冲区中的数据被丢弃 */
+    char* detach();
+
+    /* 把已缓冲的数据搬到更大的storage中，返回原来的存储空间 */
+    char* migrate(char* storage, size_t capacity);
+
+    bool attached() const {
+        return data != nullptr;
+    }
+
+    size_t capacity() const {
+        return cap;
+    }
+
+    size_t size() const {
+        return tail - head;
+    }
+
+    size_t space() const {
+        return cap - (tail - head);
+    }
+
+    bool empty() const {
+        return tail == head;
+    }
+
+    bool full() const {
+        return tail - head == cap;
+    }
+
+    uint64_t readPos() const {
+        return head;
+    }
+
+    uint64_t writePos() const {
+        return tail;
+    }
+
+    void clear() {
+        head = tail = 0;
+    }
+
+    /* 标记n字节已写入 */
+    void produce(size_t n) {
+        tail += n;
+    }
+
+    /* 标记n字节已读出 */
+    void consume(size_t n) {
+        head += n;
+    }
+
+    /* 将[pos, pos + len)区间描述为最多两个iovec，返回iovec个数 */
+    int regions(uint64_t pos, size_t len, struct iovec* iov) const;
+
+    /* 将空闲空间描述为最多两个iovec，返回iovec个数 */
+    int freeRegions(struct iovec* iov) const;
+
+    /* 将从pos开始的len字节复制到dst */
+    void copyOut(uint64_t pos, void* dst, size_t len) const;
+
+    /* 追加len字节，空间不足时返回-1 */
+    int append(const void* src, size_t len);
+
+    /* 用readv把套接字数据读入空闲空间，返回值同readv */
+    ssize_t recvFrom(int fd);
+
+    /* 用writev把缓冲的数据发送到套接字，返回值同writev */
+    ssize_t sendTo(int fd);
+};
@@ -0,0 +1,31 @@
+#pragma once
+
+#define RELAY_COPY 0   /* 经用户缓冲区转发：recv到用户空间，再send到对端 */
+#define RELAY_SPLICE 1 /* 零拷贝转发：套接字→管道→对端套接字，数据不进入用户空间 */
+
+#define BACKEND_EPOLL 0 /* epoll事件循环 */
+#define BACKEND_URING 1 /* io_uring事件循环，不可用时退回epoll */
+
+#define EPOLL_LT 0 /* 水平触发，每个事件只读写一次 */
+#define EPOLL_ET 1 /* 边沿触发，读写到EAGAIN为止 */
+
+/* 分到同一个Reactor的一组连续客户ID的个数：一个房间的成员数，或一个会话的两个客户端 */
+#define groupSize(config) ((config).room > 0 ? (config).room : 2)
+
+/* 服务器配置 */
+typedef struct ServerConfig {
+    int         threads       = 1;             /* Reactor线程数量 */
+    int         relayMode     = RELAY_COPY;    /* 转发方式 */
+    int         backend       = BACKEND_EPOLL; /* 事件循环后端 */
+    int         epollMode     = EPOLL_LT;      /* epoll触发方式 */
+    int         prealloc      = 1024;          /* 启动时预分配的连接对象总数，平均分给各Reactor */
+    const char* metrics       = nullptr;       /* 指标端口号或Unix套接字路径，nullptr表示不提供指标 */
+    const char* offline       = nullptr;       /* 离线消息目录，nullptr表示不写磁盘（仅epoll后端） */
+    size_t      offlineMemory = 0;             /* 离线消息的内存预算（字节），为0且没有目录时对端不在线则丢弃数据 */
+    int         offlineAge    = 10000;         /* 离线消息在内存中最多停留的毫秒数，之后写入磁盘 */
+    int         room          = 0;             /* 房间大小，0表示成对转发（仅epoll后端、copy模式） */
+    size_t      roomLag       = 1 << 20;       /* 房间模式下每个成员最多积压的字节数，超过时不再向它发送新报文 */
+    size_t      highWater     = 0;             /* 发送方待发数据的高水位，0表示缓冲区（管道）的容量（仅epoll） */
+    size_t      lowWater      = 0;             /* 发送方恢复接收的低水位，0表示高水位的一半 */
+    size_t      memoryBudget  = 0;             /* 缓冲字节数的全局上限，超过时暂停积压多的发送方，0不限制（仅epoll） */
+} ServerConfig;
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+/* 单生产者单消费者的无锁有界队列，容量为2的幂。
+ * 生产者只写tail，消费者只写head，两者放在不同的缓存行中，push和pop都不加锁 */
+template <typename T>
+class SpscQueue {
+private:
+    std::vector<T>                    slots; /* 存储空间 */
+    size_t                            mask;  /* 容量 - 1 */
+    alignas(64) std::atomic<uint64_t> head;  /* 下一个要取出的位置（消费者写） */
+    alignas(64) std::atomic<uint64_t> tail;  /* 下一个要放入的位置（生产者写） */
+
+public:
+    explicit SpscQueue(size_t capacity) : slots(capacity), mask(capacity - 1), head(0), tail(0) {}
+
+    SpscQueue(const SpscQueue&)            = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    /* 放入一项，队列已满时返回false（只由生产者调用） */
+    bool push(const T& item) {
+        uint64_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) > mask) {
+            return false;
+        }
+        slots[t & mask] = item;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    /* 取出一项，队列为空时返回false（只由消费者调用） */
+    bool pop(T* item) {
+        uint64_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        *item = slots[h & mask];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+};
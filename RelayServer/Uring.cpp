@@ -0,0 +1,240 @@
+#include "Uring.hpp"
+#include <algorithm>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+Uring::~Uring() {
+    if (sqes != nullptr) {
+        munmap(sqes, sqesSize);
+    }
+    if (cqRing != nullptr && cqRing != sqRing) {
+        munmap(cqRing, cqRingSize);
+    }
+    if (sqRing != nullptr) {
+        munmap(sqRing, sqRingSize);
+    }
+    if (ringfd >= 0) {
+        close(ringfd);
+    }
+}
+
+int Uring::init(unsigned entries) {
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ringfd = (int)syscall(__NR_io_uring_setup, entries, &params);
+    if (ringfd < 0) {
+        return -1;
+    }
+    sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+    }
+    sqRing = mmap(NULL, sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringfd, IORING_OFF_SQ_RING);
+    if (sqRing == MAP_FAILED) {
+        sqRing = nullptr;
+        return -1;
+    }
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        cqRing = sqRing;
+    }
+    else {
+        cqRing = mmap(NULL, cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringfd, IORING_OFF_CQ_RING);
+        if (cqRing == MAP_FAILED) {
+            cqRing = nullptr;
+            return -1;
+        }
+    }
+    sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+    sqes     = (struct io_uring_sqe*)mmap(NULL, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringfd,
+                                          IORING_OFF_SQES);
+    if (sqes == MAP_FAILED) {
+        sqes = nullptr;
+        return -1;
+    }
+    sqHead      = (unsigned*)((char*)sqRing + params.sq_off.head);
+    sqTail      = (unsigned*)((char*)sqRing + params.sq_off.tail);
+    sqArray     = (unsigned*)((char*)sqRing + params.sq_off.array);
+    sqMask      = *(unsigned*)((char*)sqRing + params.sq_off.ring_mask);
+    sqEntries   = params.sq_entries;
+    cqHead      = (unsigned*)((char*)cqRing + params.cq_off.head);
+    cqTail      = (unsigned*)((char*)cqRing + params.cq_off.tail);
+    cqMask      = *(unsigned*)((char*)cqRing + params.cq_off.ring_mask);
+    cqes        = (struct io_uring_cqe*)((char*)cqRing + params.cq_off.cqes);
+    sqLocalTail = *sqTail;
+    return 0;
+}
+
+unsigned Uring::sqSpace() {
+    unsigned head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+    if (sqLocalTail - head >= sqEntries) {
+        submit(0);
+        head = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+    }
+    return sqEntries - (sqLocalTail - head);
+}
+
+struct io_uring_sqe* Uring::getSqe() {
+    if (sqSpace() == 0) {
+        return nullptr;
+    }
+    unsigned             index = sqLocalTail & sqMask;
+    struct io_uring_sqe* sqe   = &sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqArray[index] = index;
+    sqLocalTail++;
+    pending++;
+    return sqe;
+}
+
+int Uring::submit(unsigned waitNr) {
+    __atomic_store_n(sqTail, sqLocalTail, __ATOMIC_RELEASE);
+    unsigned flags = waitNr > 0 ? IORING_ENTER_GETEVENTS : 0;
+    int      r     = (int)syscall(__NR_io_uring_enter, ringfd, pending, waitNr, flags, NULL, 0);
+    pending        = sqLocalTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+    return r;
+}
+
+struct io_uring_cqe* Uring::peekCqe() {
+    unsigned head = *cqHead;
+    if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+        return nullptr;
+    }
+    return &cqes[head & cqMask];
+}
+
+void Uring::seenCqe() {
+    __atomic_store_n(cqHead, *cqHead + 1, __ATOMIC_RELEASE);
+}
+
+int Uring::registerBufRing(struct io_uring_buf_ring* bufRing, unsigned entries, int bgid) {
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr    = (uint64_t)bufRing;
+    reg.ring_entries = entries;
+    reg.bgid         = bgid;
+    return (int)syscall(__NR_io_uring_register, ringfd, IORING_REGISTER_PBUF_RING, &reg, 1);
+}
+
+int Uring::unregisterBufRing(int bgid) {
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.bgid = bgid;
+    return (int)syscall(__NR_io_uring_register, ringfd, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+}
+
+BufRing::~BufRing() {
+    free(ring);
+    free(storage);
+}
+
+int BufRing::init(Uring* uring, unsigned entries, unsigned bufSize, int bgid) {
+    assert(entries > 0 && (entries & (entries - 1)) == 0);
+    this->uring   = uring;
+    this->entries = entries;
+    this->bufSize = bufSize;
+    this->bgid    = bgid;
+    if (posix_memalign((void**)&ring, sysconf(_SC_PAGESIZE), entries * sizeof(struct io_uring_buf)) != 0) {
+        ring = nullptr;
+        return -1;
+    }
+    storage = (char*)malloc((size_t)entries * bufSize);
+    if (storage == nullptr) {
+        return -1;
+    }
+    ring->tail = 0;
+    if (uring->registerBufRing(ring, entries, bgid) < 0 || probe() < 0) {
+        uring->unregisterBufRing(bgid);
+        legacy = 1;
+    }
+    for (unsigned bid = 0; bid < entries; ++bid) {
+        recycle(bid);
+    }
+    if (legacy) {
+        /* 等待所有缓冲区提供完毕，失败时说明内核不支持提供缓冲区 */
+        if (uring->submit(0) < 0) {
+            return -1;
+        }
+        struct io_uring_sqe* sqe = uring->getSqe();
+        if (sqe == nullptr) {
+            return -1;
+        }
+        sqe->opcode    = IORING_OP_NOP;
+        sqe->user_data = 0;
+        if (uring->submit(1) < 0) {
+            return -1;
+        }
+        struct io_uring_cqe* cqe;
+        int                  r = 0;
+        while ((cqe = uring->peekCqe()) != nullptr) {
+            r = cqe->res < 0 ? -1 : r;
+            uring->seenCqe();
+        }
+        return r;
+    }
+    return 0;
+}
+
+/* 用一个只含1字节的管道试读一次，确认内核能从缓冲区环中取到缓冲区 */
+int BufRing::probe() {
+    int fd[2];
+    if (pipe(fd) < 0) {
+        return -1;
+    }
+    recycle(0);
+    char                 c   = 0;
+    int                  r   = -1;
+    struct io_uring_sqe* sqe = nullptr;
+    if (write(fd[1], &c, 1) == 1 && (sqe = uring->getSqe()) != nullptr) {
+        sqe->opcode    = IORING_OP_READ;
+        sqe->fd        = fd[0];
+        sqe->len       = bufSize;
+        sqe->flags     = IOSQE_BUFFER_SELECT;
+        sqe->buf_group = bgid;
+        sqe->user_data = 0;
+        if (uring->submit(1) >= 0) {
+            struct io_uring_cqe* cqe = uring->peekCqe();
+            if (cqe != nullptr) {
+                r = cqe->res == 1 ? 0 : -1;
+                uring->seenCqe();
+            }
+        }
+    }
+    close(fd[0]);
+    close(fd[1]);
+    return r;
+}
+
+void BufRing::recycle(uint16_t bid) {
+    if (legacy) {
+        struct io_uring_sqe* sqe = uring->getSqe();
+        /* 提交队列已满，留到下一轮flushDeferred再归还 */
+        if (sqe == nullptr) {
+            deferred.push_back(bid);
+            return;
+        }
+        sqe->opcode    = IORING_OP_PROVIDE_BUFFERS;
+        sqe->fd        = 1; /* 缓冲区个数 */
+        sqe->addr      = (uint64_t)buffer(bid);
+        sqe->len       = bufSize;
+        sqe->off       = bid;
+        sqe->buf_group = bgid;
+        sqe->flags     = IOSQE_CQE_SKIP_SUCCESS;
+        sqe->user_data = 0;
+        return;
+    }
+    struct io_uring_buf* buf = &ring->bufs[tail & (entries - 1)];
+    buf->addr                = (uint64_t)buffer(bid);
+    buf->len                 = bufSize;
+    buf->bid                 = bid;
+    tail++;
+    __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+}
+
+void BufRing::flushDeferred() {
+    std::vector<uint16_t> bids;
+    bids.swap(deferred);
+    for (uint16_t bid : bids) {
+        recycle(bid);
+    }
+}
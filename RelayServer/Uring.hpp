@@ -0,0 +1,101 @@
+#pragma once
+
+#include "../common/common.hpp"
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <vector>
+
+/* 直接基于io_uring系统调用的最小封装（不依赖liburing） */
+class Uring {
+private:
+    int                  ringfd      = -1;      /* io_uring描述符 */
+    void*                sqRing      = nullptr; /* 提交队列映射 */
+    void*                cqRing      = nullptr; /* 完成队列映射 */
+    size_t               sqRingSize  = 0;
+    size_t               cqRingSize  = 0;
+    struct io_uring_sqe* sqes        = nullptr; /* 提交队列项数组 */
+    size_t               sqesSize    = 0;
+    unsigned*            sqHead      = nullptr;
+    unsigned*            sqTail      = nullptr;
+    unsigned*            sqArray     = nullptr;
+    unsigned             sqMask      = 0;
+    unsigned             sqEntries   = 0;
+    unsigned*            cqHead      = nullptr;
+    unsigned*            cqTail      = nullptr;
+    unsigned             cqMask      = 0;
+    struct io_uring_cqe* cqes        = nullptr; /* 完成队列项数组 */
+    unsigned             sqLocalTail = 0;       /* 已填写但尚未提交的提交队列尾 */
+    unsigned             pending     = 0;       /* 尚未提交的提交队列项数量 */
+
+public:
+    ~Uring();
+
+    /* 创建io_uring并映射队列，失败返回-1（内核不支持时errno为ENOSYS） */
+    int init(unsigned entries);
+
+    /* 提交队列中的空闲项数，队列已满时先提交已有的项 */
+    unsigned sqSpace();
+
+    /* 获取一个清零的提交队列项，队列已满时先提交已有的项，仍然满（如完成队列溢出时内核拒绝提交）返回nullptr */
+    struct io_uring_sqe* getSqe();
+
+    /* 提交所有待提交的项，并至少等待waitNr个完成事件，返回值同io_uring_enter */
+    int submit(unsigned waitNr);
+
+    /* 取出下一个完成事件，没有时返回nullptr */
+    struct io_uring_cqe* peekCqe();
+
+    /* 标记peekCqe返回的完成事件已处理 */
+    void seenCqe();
+
+    /* 注册一个提供缓冲区环，bufRing需按页对齐，entries必须是2的幂 */
+    int registerBufRing(struct io_uring_buf_ring* bufRing, unsigned entries, int bgid);
+
+    /* 注销第bgid组提供缓冲区环 */
+    int unregisterBufRing(int bgid);
+};
+
+/* 提供缓冲区环：内核在接收时从中挑选缓冲区，用户处理完后归还。
+ * 注册了缓冲区环却无法从中取到缓冲区的内核上，退回用IORING_OP_PROVIDE_BUFFERS逐个归还 */
+class BufRing {
+private:
+    Uring*                    uring   = nullptr;
+    struct io_uring_buf_ring* ring    = nullptr; /* 与内核共享的环 */
+    char*                     storage = nullptr; /* 所有缓冲区的存储空间 */
+    unsigned                  entries = 0;       /* 缓冲区个数，2的幂 */
+    unsigned                  bufSize = 0;       /* 每个缓冲区的大小 */
+    int                       bgid    = 0;       /* 缓冲区组号 */
+    uint16_t                  tail    = 0;       /* 本地维护的环尾 */
+    int                       legacy  = 0;       /* 是否使用IORING_OP_PROVIDE_BUFFERS */
+    std::vector<uint16_t>     deferred;          /* 提交队列已满时未能归还的缓冲区 */
+
+    int probe();
+
+public:
+    ~BufRing();
+
+    /* 分配entries个bufSize大小的缓冲区并注册为第bgid组 */
+    int init(Uring* uring, unsigned entries, unsigned bufSize, int bgid);
+
+    char* buffer(uint16_t bid) const {
+        return storage + (size_t)bid * bufSize;
+    }
+
+    unsigned size() const {
+        return bufSize;
+    }
+
+    /* 把缓冲区bid归还给内核 */
+    void recycle(uint16_t bid);
+
+    /* 重新归还提交队列已满时未能归还的缓冲区 */
+    void flushDeferred();
+
+    int hasDeferred() const {
+        return !deferred.empty();
+    }
+
+    int isLegacy() const {
+        return legacy;
+    }
+};
@@ -1,11 +1,93 @@
 #include "RelayServer.hpp"
 
+static void usage() {
+    printf("usage: RelayServer [-t Threads] [-m copy|splice] [-b epoll|uring] [-e lt|et] [-p Prealloc] [-M MetricsPort|MetricsSocketPath] [-s OfflineDir] [-q OfflineMemoryMB] [-a OfflineAgeMs] [-r RoomSize] [-l RoomLagKB] [-w HighKB:LowKB] [-g BudgetMB] <IP_Address> <Port>\n");
+}
+
 int main(int argc, char** argv) {
-    if (argc != 3) {
-        printf("usage: RelayServer <IP_Address> <Port>\n");
+    ServerConfig config;
+    int          opt;
+    while ((opt = getopt(argc, argv, "t:m:b:e:p:M:s:q:a:r:l:w:g:")) != -1) {
+        switch (opt) {
+        case 't':
+            config.threads = atoi(optarg);
+            break;
+        case 'p':
+            config.prealloc = atoi(optarg);
+            break;
+        case 'M':
+            config.metrics = optarg;
+            break;
+        case 's':
+            config.offline = optarg;
+            break;
+        case 'q':
+            config.offlineMemory = (size_t)atoi(optarg) << 20;
+            break;
+        case 'a':
+            config.offlineAge = atoi(optarg);
+            break;
+        case 'r':
+            config.room = atoi(optarg);
+            break;
+        case 'l':
+            config.roomLag = (size_t)atoi(optarg) << 10;
+            break;
+        case 'w':
+            config.highWater = (size_t)atoi(optarg) << 10;
+            if (strchr(optarg, ':') != nullptr) {
+                config.lowWater = (size_t)atoi(strchr(optarg, ':') + 1) << 10;
+            }
+            break;
+        case 'g':
+            config.memoryBudget = (size_t)atoi(optarg) << 20;
+            break;
+        case 'm':
+            if (strcmp(optarg, "copy") == 0) {
+                config.relayMode = RELAY_COPY;
+            }
+            else if (strcmp(optarg, "splice") == 0) {
+                config.relayMode = RELAY_SPLICE;
+            }
+            else {
+                usage();
+                return 0;
+            }
+            break;
+        case 'b':
+            if (strcmp(optarg, "epoll") == 0) {
+                config.backend = BACKEND_EPOLL;
+            }
+            else if (strcmp(optarg, "uring") == 0) {
+                config.backend = BACKEND_URING;
+            }
+            else {
+                usage();
+                return 0;
+            }
+            break;
+        case 'e':
+            if (strcmp(optarg, "lt") == 0) {
+                config.epollMode = EPOLL_LT;
+            }
+            else if (strcmp(optarg, "et") == 0) {
+                config.epollMode = EPOLL_ET;
+            }
+            else {
+                usage();
+                return 0;
+            }
+            break;
+        default:
+            usage();
+            return 0;
+        }
+    }
+    if (argc - optind != 2) {
+        usage();
         return 0;
     }
-    RelayServer server;
-    server.start(argv[1], argv[2], 1);
+    RelayServer server(config);
+    server.start(argv[optind], argv[optind + 1], 1);
     return 0;
 }
@@ -0,0 +1,144 @@
+#!/bin/bash
+# 回环端到端基准测试：对scenarios.txt中的每个场景在127.0.0.1上启动RelayServer和PressureGenerator，
+# 把吞吐量和p99延迟写入结果文件，并与基线比较，超过容差的退化使测试失败。
+#
+# 用法: loopback_bench.sh <RelayServer> <PressureGenerator> <场景文件> <基线文件> [结果文件]
+# 环境变量:
+#   BENCH_TOLERANCE      吞吐量允许的相对下降，默认0.25（低于基线的75%视为退化）
+#   BENCH_P99_TOLERANCE  p99允许的相对上升，默认0.5，尾延迟比吞吐量抖动得多
+#   BENCH_P99_SLACK      p99的绝对容差（毫秒），默认1，避免很小的延迟因抖动误报
+#   BENCH_FILTER         只运行名称匹配该正则表达式的场景
+#   BENCH_UPDATE         为1时把本次结果合并到基线文件（只替换运行过的场景，可与BENCH_FILTER一起使用），
+#                        接受吞吐量和延迟的变化；有场景未能运行或收到损坏的报文时不更新
+#   BENCH_PORT           第一个场景使用的端口，之后每个场景加1，默认19100
+
+SERVER=$1
+GENERATOR=$2
+SCENARIOS=$3
+BASELINE=$4
+RESULTS=${5:-loopback_results.tsv}
+TOLERANCE=${BENCH_TOLERANCE:-0.25}
+P99_TOLERANCE=${BENCH_P99_TOLERANCE:-0.5}
+SLACK=${BENCH_P99_SLACK:-1}
+PORT=${BENCH_PORT:-19100}
+
+if [ $# -lt 4 ] || [ ! -x "$SERVER" ] || [ ! -x "$GENERATOR" ] || [ ! -f "$SCENARIOS" ]; then
+    echo "usage: loopback_bench.sh <RelayServer> <PressureGenerator> <Scenarios> <Baseline> [Results]"
+    exit 2
+fi
+
+# 服务器和发生器会在当前目录写log和gmon.out，放到临时目录中
+WORKDIR=$(mktemp -d)
+trap 'rm -rf "$WORKDIR"' EXIT
+SERVER=$(realpath "$SERVER")
+GENERATOR=$(realpath "$GENERATOR")
+RESULTS=$(realpath -m "$RESULTS")
+
+# 等待端口进入监听状态，最多5秒
+waitListen() {
+    for _ in $(seq 50); do
+        if ss -Hltn "sport = :$1" 2>/dev/null | grep -q .; then
+            return 0
+        fi
+        sleep 0.1
+    done
+    return 1
+}
+
+# 从发生器的输出中取出一项统计
+stat() {
+    awk -v key="$1:" '$1 == key { print $2; exit }' "$2"
+}
+
+printf "scenario\trecvSpeed\tp99Delay\trecvPackets\trecvLost\trecvCorrupted\n" > "$RESULTS"
+failed=0
+while IFS='|' read -r name serverArgs genArgs sessions seconds size; do
+    case "$name" in
+        ''|'#'*) continue ;;
+    esac
+    if [ -n "$BENCH_FILTER" ] && ! [[ "$name" =~ $BENCH_FILTER ]]; then
+        continue
+    fi
+    dir="$WORKDIR/$name"
+    mkdir -p "$dir"
+    (cd "$dir" && exec "$SERVER" $serverArgs 127.0.0.1 "$PORT" > server.out 2>&1) &
+    server=$!
+    if ! waitListen "$PORT"; then
+        echo "$name: RelayServer did not start"
+        kill -9 $server 2>/dev/null
+        failed=1
+        PORT=$((PORT + 1))
+        continue
+    fi
+    (cd "$dir" && timeout $((seconds + 60)) "$GENERATOR" $genArgs 127.0.0.1 "$PORT" "$sessions" "$seconds" "$size" \
+        > generator.out 2>&1)
+    kill -INT $server 2>/dev/null
+    timeout 30 tail --pid=$server -f /dev/null || kill -9 $server 2>/dev/null
+    wait $server 2>/dev/null
+    PORT=$((PORT + 1))
+
+    speed=$(stat recvSpeed "$dir/generator.out")
+    if [ -z "$speed" ]; then
+        echo "$name: no statistics from PressureGenerator"
+        tail -n 5 "$dir/generator.out"
+        failed=1
+        continue
+    fi
+    p99=$(stat p99Delay "$dir/generator.out")
+    packets=$(stat recvPackets "$dir/generator.out")
+    lost=$(stat recvLost "$dir/generator.out")
+    corrupted=$(stat recvCorrupted "$dir/generator.out")
+    printf "%s\t%s\t%s\t%s\t%s\t%s\n" "$name" "$speed" "$p99" "$packets" "$lost" "$corrupted" >> "$RESULTS"
+done < "$SCENARIOS"
+
+# 与基线逐项比较：吞吐量下降或p99上升超过容差即为退化，收到损坏的报文总是失败。
+# 退出码：0表示通过，1表示有退化，2表示有场景未能运行或收到损坏的报文
+baseline="$BASELINE"
+if [ ! -s "$baseline" ]; then
+    baseline="$WORKDIR/empty.tsv"
+    head -n 1 "$RESULTS" > "$baseline"
+fi
+awk -F'\t' -v tol="$TOLERANCE" -v p99tol="$P99_TOLERANCE" -v slack="$SLACK" -v broken="$failed" '
+    FNR == 1 { next }
+    FNR == NR { baseSpeed[$1] = $2; baseP99[$1] = $3; next }
+    {
+        status = "ok"
+        if ($6 > 0) {
+            status = "CORRUPTED"
+            broken = 1
+        }
+        else if (!($1 in baseSpeed)) {
+            status = "no baseline"
+        }
+        else if ($2 < baseSpeed[$1] * (1 - tol)) {
+            status = "THROUGHPUT REGRESSION"
+        }
+        else if ($3 > baseP99[$1] * (1 + p99tol) && $3 > baseP99[$1] + slack) {
+            status = "P99 REGRESSION"
+        }
+        if (status ~ /REGRESSION$/) {
+            regressed = 1
+        }
+        base = ($1 in baseSpeed) ? sprintf("%.1f MB/s, p99 %.3f ms", baseSpeed[$1] / 1048576, baseP99[$1]) : "-"
+        printf "%-16s %10.1f MB/s  p99 %10.3f ms  lost %-6s (baseline: %s)  %s\n", $1, $2 / 1048576, $3, $5, base, status
+    }
+    END { exit broken ? 2 : regressed }
+' "$baseline" "$RESULTS"
+failed=$?
+
+if [ "$BENCH_UPDATE" = "1" ]; then
+    if [ $failed -eq 2 ]; then
+        echo "baseline not updated: a scenario did not run or received corrupted packets"
+        exit $failed
+    fi
+    # 基线中的场景按原顺序保留，运行过的替换为本次结果，新场景追加在最后
+    awk -F'\t' '
+        FNR == NR { if (FNR > 1) { row[$1] = $0; order[++count] = $1 } next }
+        FNR == 1 { print; next }
+        { if ($1 in row) { print row[$1]; delete row[$1] } else { print } }
+        END { for (i = 1; i <= count; i++) if (order[i] in row) print row[order[i]] }
+    ' "$RESULTS" "$baseline" > "$WORKDIR/baseline.tsv" && cp "$WORKDIR/baseline.tsv" "$BASELINE"
+    echo "baseline updated: $BASELINE"
+    exit 0
+fi
+exit $failed
@@ -0,0 +1,285 @@
+#include "../RelayServer/Reactor.hpp"
+#include <atomic>
+#include <functional>
+#include <sys/socket.h>
+
+#define BENCH_MIN_NS 200000000ULL /* 每项基准至少运行的时间（纳秒） */
+#define BENCH_RING_SIZE 65536     /* 报文解析基准使用的环形缓冲区大小 */
+#define BENCH_CHUNK 1448          /* 模拟一次recv得到的字节数（一个以太网MSS） */
+#define BENCH_RELAY_BYTES (64 << 20)
+
+/* 阻止编译器把结果当作无用计算删除 */
+template <typename T>
+static inline void keep(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+static const char* g_filter = nullptr; /* 只运行名字包含该字符串的基准 */
+
+/* 基准名是否匹配命令行给出的过滤串 */
+static int selected(const char* name) {
+    return g_filter == nullptr || strstr(name, g_filter) != nullptr;
+}
+
+/* 反复调用fn，调用次数逐次翻倍直到总用时超过BENCH_MIN_NS。
+ * 每次调用完成items个操作、处理bytes字节，输出每个操作的纳秒数和吞吐量 */
+static void bench(const char* name, size_t items, size_t bytes, const std::function<void()>& fn) {
+    if (!selected(name)) {
+        return;
+    }
+    fn(); /* 预热 */
+    uint64_t calls = 1, elapsed = 0;
+    while (true) {
+        uint64_t start = nowNs();
+        for (uint64_t i = 0; i < calls; ++i) {
+            fn();
+        }
+        elapsed = nowNs() - start;
+        if (elapsed >= BENCH_MIN_NS || calls >= (1ULL << 40)) {
+            break;
+        }
+        calls = elapsed == 0 ? calls * 16 : std::max<uint64_t>(calls * 2, calls * BENCH_MIN_NS / elapsed * 5 / 4);
+    }
+    double ops = (double)calls * items;
+    printf("%-32s %14.0f %12.2f", name, ops, elapsed / ops);
+    if (bytes > 0) {
+        printf(" %12.2f", (double)calls * bytes / elapsed * NANO_SEC / (1 << 20));
+    }
+    printf("\n");
+    fflush(stdout);
+}
+
+/* 在buf中写入首尾相接、载荷大小为payload的报文，返回写入的字节数（不超过size） */
+static size_t fillPackets(char* buf, size_t size, size_t payload, size_t* count) {
+    size_t used = 0;
+    *count      = 0;
+    while (used + sizeof(Header) + payload <= size) {
+        Header header;
+        getHeader(payload, (uint32_t)*count, &header);
+        memcpy(buf + used, &header, sizeof(Header));
+        memset(buf + used + sizeof(Header), 'a', payload);
+        used += sizeof(Header) + payload;
+        (*count)++;
+    }
+    return used;
+}
+
+/* 直接调用Reactor转发路径上的私有函数，Reactor不启动线程 */
+class RelayBench {
+private:
+    ServerConfig config;
+    IdAllocator  allocator;
+    Reactor      reactor;
+
+public:
+    RelayBench() : reactor(0, &config, &allocator, nullptr) {}
+
+    void headers() {
+        uint64_t values[256];
+        for (size_t i = 0; i < 256; ++i) {
+            values[i] = i * 0x9E3779B97F4A7C15ULL;
+        }
+        bench("ntoh64", 256, 0, [&]() {
+            for (size_t i = 0; i < 256; ++i) {
+                keep(ntoh64(values[i]));
+            }
+        });
+        bench("hton64", 256, 0, [&]() {
+            for (size_t i = 0; i < 256; ++i) {
+                keep(hton64(values[i]));
+            }
+        });
+        Header header;
+        bench("getHeader", 1, 0, [&]() {
+            getHeader(1000, 1, &header);
+            keep(header);
+        });
+        ClientInfo client;
+        bench("handleHeader", 1, 0, [&]() { keep(reactor.handleHeader(&header, &client)); });
+    }
+
+    /* epoll路径：报文状态机在环形缓冲区上解析，chunk为每次交给状态机的字节数 */
+    void consumeRing(size_t payload, size_t chunk) {
+        char*      storage = new char[BENCH_RING_SIZE];
+        ClientInfo client;
+        client.cliID = 0;
+        client.ring.attach(storage, BENCH_RING_SIZE);
+        size_t count;
+        size_t used = fillPackets(storage, BENCH_RING_SIZE, payload, &count);
+        client.ring.produce(used);
+        char name[64];
+        snprintf(name, sizeof(name), "consumeRing/%zu/%zu", payload, chunk);
+        bench(name, count, used, [&]() {
+            for (size_t pos = 0; pos < used; pos += chunk) {
+                reactor.consumeRing(&client, &client, pos, std::min(chunk, used - pos));
+            }
+        });
+        client.ring.detach();
+        delete[] storage;
+    }
+
+    /* io_uring路径：报文状态机在连续的提供缓冲区上解析 */
+    void consumeFrames(size_t payload, size_t chunk) {
+        char*  storage = new char[BENCH_RING_SIZE];
+        size_t count;
+        size_t used = fillPackets(storage, BENCH_RING_SIZE, payload, &count);
+        ClientInfo client;
+        char       name[64];
+        snprintf(name, sizeof(name), "consumeFrames/%zu/%zu", payload, chunk);
+        bench(name, count, used, [&]() {
+            for (size_t pos = 0; pos < used; pos += chunk) {
+                reactor.consumeFrames(&client, storage + pos, std::min(chunk, used - pos));
+            }
+        });
+        delete[] storage;
+    }
+};
+
+/* 环形缓冲区：跨越回绕点的追加与复制，以及缓冲区升级时把数据搬到更大的存储空间 */
+static void ringBuffers() {
+    char*      small = new char[BufferPool::tierSize(0)];
+    char*      large = new char[BufferPool::tierSize(1)];
+    char       packet[1000];
+    RingBuffer ring;
+    memset(packet, 'a', sizeof(packet));
+    ring.attach(small, BufferPool::tierSize(0));
+    bench("ring/append+copyOut/1000", 1, sizeof(packet), [&]() {
+        ring.append(packet, sizeof(packet));
+        ring.copyOut(ring.readPos(), packet, sizeof(packet));
+        ring.consume(sizeof(packet));
+    });
+    size_t len = BufferPool::tierSize(0) * 3 / 4;
+    bench("ring/migrate/4K->16K", 1, len, [&]() {
+        ring.attach(small, BufferPool::tierSize(0));
+        ring.produce(len);
+        ring.consume(len);
+        ring.produce(len); /* 数据跨越回绕点 */
+        small = ring.migrate(large, BufferPool::tierSize(1));
+        large = ring.detach();
+    });
+    BufferPool pool;
+    for (int tier = 0; tier < BUFFER_TIERS; ++tier) {
+        char name[64];
+        snprintf(name, sizeof(name), "bufferPool/acquire+release/%zuK", BufferPool::tierSize(tier) >> 10);
+        bench(name, 1, 0, [&]() {
+            char* buf = pool.acquire(tier);
+            keep(buf);
+            pool.release(buf, tier);
+        });
+    }
+    delete[] small;
+    delete[] large;
+}
+
+/* send/recv的返回值是否表示失败：出错或连接被关闭时打印原因，EINTR和EAGAIN只需重试 */
+static int ioFailed(ssize_t n, const char* what) {
+    if (n > 0 || (n < 0 && (errno == EINTR || errno == EAGAIN))) {
+        return 0;
+    }
+    if (n == 0) {
+        fprintf(stderr, "relay_bench: %s: connection closed\n", what);
+    }
+    else {
+        fprintf(stderr, "relay_bench: %s: %s\n", what, strerror(errno));
+    }
+    return 1;
+}
+
+/* 完整的转发路径：一个会话的两个客户端各是一对socketpair的一端，交给真正的Reactor线程，
+ * 基准从一端写入报文、从另一端读出。stream测流水线吞吐量，pingpong测单个报文的往返用时 */
+static void relay(const char* mode, int epollMode, int relayMode, size_t payload) {
+    char stream[64], pingpong[64];
+    snprintf(stream, sizeof(stream), "relay/%s/stream/%zu", mode, payload);
+    snprintf(pingpong, sizeof(pingpong), "relay/%s/pingpong/%zu", mode, payload);
+    if (!selected(stream) && !selected(pingpong)) {
+        return;
+    }
+    ServerConfig config;
+    config.epollMode = epollMode;
+    config.relayMode = relayMode;
+    IdAllocator allocator;
+    Reactor     reactor(0, &config, &allocator, nullptr);
+    int         a[2], b[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, a) < 0 || socketpair(AF_UNIX, SOCK_STREAM, 0, b) < 0
+        || reactor.start() < 0) {
+        perror("relay_bench");
+        return;
+    }
+    setnonblocking(a[1]);
+    setnonblocking(b[1]);
+    reactor.dispatch(a[1], 0);
+    reactor.dispatch(b[1], 1);
+
+    size_t count;
+    size_t size   = (sizeof(Header) + payload) * 64;
+    char*  packet = new char[size];
+    char*  buf    = new char[size];
+    size          = fillPackets(packet, size, payload, &count);
+    /* 转发出错后不再收发，余下的调用立即返回，测得的结果无意义 */
+    std::atomic<int> failed(0);
+    /* 写满整个套接字缓冲区后再读会死锁，由另一个线程写 */
+    size_t rounds = BENCH_RELAY_BYTES / size + 1;
+    bench(stream, count * rounds, size * rounds, [&]() {
+        std::thread writer([&]() {
+            for (size_t i = 0; i < rounds && !failed; ++i) {
+                for (size_t sent = 0; sent < size && !failed;) {
+                    ssize_t n = send(a[0], packet + sent, size - sent, MSG_NOSIGNAL);
+                    if (ioFailed(n, "send")) {
+                        failed = 1;
+                    }
+                    sent += n > 0 ? n : 0;
+                }
+            }
+        });
+        for (size_t recved = 0; recved < size * rounds && !failed;) {
+            ssize_t n = recv(b[0], buf, size, 0);
+            if (ioFailed(n, "recv")) {
+                failed = 1;
+                shutdown(a[0], SHUT_RDWR); /* 唤醒阻塞在send中的写线程 */
+            }
+            recved += n > 0 ? n : 0;
+        }
+        writer.join();
+    });
+    size_t one = sizeof(Header) + payload;
+    bench(pingpong, 1, one, [&]() {
+        if (failed || ioFailed(send(a[0], packet, one, MSG_NOSIGNAL), "send")) {
+            failed = 1;
+            return;
+        }
+        for (size_t recved = 0; recved < one;) {
+            ssize_t n = recv(b[0], buf, one - recved, 0);
+            if (ioFailed(n, "recv")) {
+                failed = 1;
+                return;
+            }
+            recved += n > 0 ? n : 0;
+        }
+    });
+    close(a[0]);
+    close(b[0]);
+    reactor.stop();
+    reactor.join();
+    delete[] packet;
+    delete[] buf;
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1) {
+        g_filter = argv[1];
+    }
+    printf("%-32s %14s %12s %12s\n", "benchmark", "ops", "ns/op", "MB/s");
+    RelayBench relayBench;
+    relayBench.headers();
+    for (size_t payload : { 64, 1024, 16384 }) {
+        relayBench.consumeRing(payload, BENCH_RING_SIZE);
+        relayBench.consumeRing(payload, BENCH_CHUNK);
+        relayBench.consumeFrames(payload, BENCH_CHUNK);
+    }
+    ringBuffers();
+    for (size_t payload : { 64, 1024, 16384 }) {
+        relay("lt", EPOLL_LT, RELAY_COPY, payload);
+        relay("et", EPOLL_ET, RELAY_COPY, payload);
+    }
+    return 0;
+}
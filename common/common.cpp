@@ -1,4 +1,5 @@
 #include "common.hpp"
+#include <algorithm>
 
 #define LOGGER_PRETTY_TIME_FORMAT "%Y-%m-%d %H:%M:%S"
 #define LOGGER_PRETTY_MS_FORMAT ".%03ld"
@@ -44,51 +45,64 @@ uint64_t hton64(uint64_t host64) {
         return host64;
 }
 
+uint64_t nowNs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * (uint64_t)NANO_SEC + now.tv_nsec;
+}
+
 struct timespec getHeader(uint16_t length, uint32_t id, Header* header) {
-    header->length = htons(length);
-    header->id     = htonl(id);
     struct timespec timestamp;
     clock_gettime(CLOCK_REALTIME, &timestamp);
-    assert(timestamp.tv_nsec < NANO_SEC);
-    header->sec  = hton64(timestamp.tv_sec);
-    header->nsec = hton64(timestamp.tv_nsec);
+    setHeader(length, id, &timestamp, header);
     return timestamp;
 }
 
-int logInfo(int returnValue, FILE* fp, const char* fmt, ...) {
+void setHeader(uint16_t length, uint32_t id, const struct timespec* timestamp, Header* header) {
+    assert(timestamp->tv_nsec < NANO_SEC);
+    header->length = htons(length);
+    header->id     = htonl(id);
+    header->sec    = hton64(timestamp->tv_sec);
+    header->nsec   = hton64(timestamp->tv_nsec);
+}
+
+int logWrite(int level, int returnValue, FILE* fp, const char* fmt, ...) {
     if (fp == nullptr) {
         return returnValue;
     }
-    fprintf(fp, "%s - INFO - ", prettyTime().c_str());
-    char    msgBuf[LINE_MAX + 1];
+    int errno_save = errno;
+    /* 同一秒内的日志复用格式化好的时间前缀，只补上毫秒 */
+    static thread_local time_t cachedSec = -1;
+    static thread_local char   cachedTime[32];
+    struct timespec            now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    if (now.tv_sec != cachedSec) {
+        struct tm time0;
+        localtime_r(&now.tv_sec, &time0);
+        strftime(cachedTime, sizeof(cachedTime), LOGGER_PRETTY_TIME_FORMAT, &time0);
+        cachedSec = now.tv_sec;
+    }
+    char line[LOG_SLOT_SIZE];
+    int  n = snprintf(line, sizeof(line), "%s" LOGGER_PRETTY_MS_FORMAT " - %s - ", cachedTime,
+                      now.tv_nsec / 1000000, level == LOG_LEVEL_ERROR ? "ERROR" : "INFO");
     va_list ap;
     va_start(ap, fmt);
-    vsnprintf(msgBuf, LINE_MAX, fmt, ap);
+    int m = vsnprintf(line + n, LINE_MAX, fmt, ap);
     va_end(ap);
-    strcat(msgBuf, "\n");
-    fprintf(fp, "%s", msgBuf);
-    fflush(fp);
+    n += std::max(0, std::min(m, LINE_MAX - 1));
+    if (level == LOG_LEVEL_ERROR && errno_save != 0) {
+        m = snprintf(line + n, sizeof(line) - n - 1, ": %s", strerror(errno_save));
+        n += std::max(0, std::min(m, (int)sizeof(line) - n - 2));
+    }
+    line[n++] = '\n';
+    Logger::instance().push(fp, line, n);
     return returnValue;
 }
 
-int logError(int returnValue, FILE* fp, const char* fmt, ...) {
-    if (fp == nullptr) {
-        return returnValue;
+void logFlush(FILE* fp) {
+    if (fp != nullptr) {
+        Logger::instance().flush(fp);
     }
-    fprintf(fp, "%s - ERROR - ", prettyTime().c_str());
-    int     errno_save = errno;
-    char    msgBuf[LINE_MAX + 1];
-    va_list ap;
-    va_start(ap, fmt);
-    vsnprintf(msgBuf, LINE_MAX, fmt, ap);
-    va_end(ap);
-    int n = strlen(msgBuf);
-    if (errno_save != 0)
-        snprintf(msgBuf + n, LINE_MAX - n, ": %s", strerror(errno_save));
-    strcat(msgBuf, "\n");
-    fprintf(fp, "%s", msgBuf);
-    fflush(fp);
-    return returnValue;
 }
 
 int createSocket(int family, int type, int protocol, FILE* fp) {
@@ -160,18 +174,19 @@ void addfd(int epollfd, int fd, int enable_out, int enable_et) {
     epoll_ctl(epollfd, EPOLL_CTL_ADD, fd, &event);
 }
 
-void modfd(int epollfd, int fd, int enalbeIn, int enableOut) {
-    if (enalbeIn == 0 && enableOut == 0)
-        return;
+void modfd(int epollfd, int fd, int enalbeIn, int enableOut, int enableEt) {
     struct epoll_event event;
     event.data.fd = fd;
+    event.events  = 0; /* 都不关注时仍会报告EPOLLHUP和EPOLLERR */
     if (enalbeIn) {
-        event.events = EPOLLIN;
-        event.events = enableOut ? event.events | EPOLLOUT : event.events;
-        epoll_ctl(epollfd, EPOLL_CTL_MOD, fd, &event);
-        return;
+        event.events |= EPOLLIN;
+    }
+    if (enableOut) {
+        event.events |= EPOLLOUT;
+    }
+    if (enableEt) {
+        event.events |= EPOLLET;
     }
-    event.events = EPOLLOUT;
     epoll_ctl(epollfd, EPOLL_CTL_MOD, fd, &event);
 }
 
@@ -1,3 +1,6 @@
+#pragma once
+
+#include "logger.hpp"
 #include <arpa/inet.h>
 #include <assert.h>
 #include <byteswap.h>
@@ -23,8 +26,6 @@
 #include <wait.h>
 
 #define NANO_SEC 1000000000
-#define SAVE_FILE 0
-#define BETTER_EPOLL 0
 #define NAME_MAX 255                                       /* chars in a file name */
 #define LINE_MAX 255                                       /* char in one line of log file */
 #define MAX_EVENT_NUMBER 30000                             /* 事件数 */
@@ -58,14 +59,14 @@ uint64_t ntoh64(uint64_t net64);
 /* 将64字节变量从主机字节序变为网络字节序 */
 uint64_t hton64(uint64_t host64);
 
+/* 获取单调时钟的当前时间（纳秒） */
+uint64_t nowNs();
+
 /* 获取一个自动计算当前时间的Header */
 struct timespec getHeader(uint16_t length, uint32_t id, Header* header);
 
-/* 打印非errno消息到log文件 */
-int logInfo(int returnValue, FILE* fp, const char* fmt, ...);
-
-/* 打印errno消息到log文件 */
-int logError(int returnValue, FILE* fp, const char* fmt, ...);
+/* 获取一个使用指定时间戳的Header */
+void setHeader(uint16_t length, uint32_t id, const struct timespec* timestamp, Header* header);
 
 /* 创建套接字 */
 int createSocket(int family, int type, int protocol, FILE* fp = nullptr);
@@ -94,4 +95,5 @@ void addfd(int epollfd, int fd, int enable_out, int enable_et);
 /* 将文件描述符从epoll事件表中删除 */
 void delfd(int epollfd, int fd);
 
-void modfd(int epollfd, int fd, int enalbeIn, int enableOut);
\ No newline at end of file
+/* 修改fd关注的事件，ET模式下每次修改都会重新检查就绪状态，就绪时立即产生一次事件 */
+void modfd(int epollfd, int fd, int enalbeIn, int enableOut, int enableEt = 0);
\ No newline at end of file
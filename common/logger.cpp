@@ -0,0 +1,117 @@
+#include "common.hpp"
+#include <algorithm>
+
+Logger::Logger()
+    : enqueuePos(0), dequeuePos(0), flushedPos(0), dropped(0), sleeping(0), stopFlag(0), reported(0) {
+    static_assert((LOG_RING_SIZE & (LOG_RING_SIZE - 1)) == 0, "LOG_RING_SIZE must be a power of 2");
+    slots = new Slot[LOG_RING_SIZE];
+    for (uint64_t i = 0; i < LOG_RING_SIZE; ++i) {
+        slots[i].seq.store(i, std::memory_order_relaxed);
+    }
+}
+
+Logger::~Logger() {
+    stopFlag.store(1);
+    cond.notify_one();
+    if (writer.joinable()) {
+        writer.join();
+    }
+    delete[] slots;
+}
+
+Logger& Logger::instance() {
+    static Logger logger;
+    return logger;
+}
+
+int Logger::push(FILE* fp, const char* line, size_t len) {
+    std::call_once(started, [this] { writer = std::thread(&Logger::run, this); });
+    uint64_t pos = enqueuePos.load(std::memory_order_relaxed);
+    Slot*    slot;
+    while (true) {
+        slot         = &slots[pos & (LOG_RING_SIZE - 1)];
+        int64_t diff = (int64_t)slot->seq.load(std::memory_order_acquire) - (int64_t)pos;
+        if (diff == 0) {
+            if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        }
+        else if (diff < 0) { /* 队列已满，后台线程还没有写完一整圈 */
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return -1;
+        }
+        else {
+            pos = enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+    len       = std::min(len, (size_t)LOG_SLOT_SIZE);
+    slot->fp  = fp;
+    slot->len = (uint16_t)len;
+    memcpy(slot->line, line, len);
+    slot->seq.store(pos + 1, std::memory_order_seq_cst);
+    if (sleeping.load(std::memory_order_seq_cst)) {
+        cond.notify_one();
+    }
+    return 0;
+}
+
+/* 写出队列中所有可读的日志，队列空时fflush写过的文件，返回写出的行数 */
+int Logger::drain() {
+    int   n      = 0;
+    FILE* lastFp = nullptr;
+    while (true) {
+        uint64_t pos  = dequeuePos.load(std::memory_order_relaxed);
+        Slot*    slot = &slots[pos & (LOG_RING_SIZE - 1)];
+        if (slot->seq.load(std::memory_order_acquire) != pos + 1) {
+            break;
+        }
+        fwrite(slot->line, 1, slot->len, slot->fp);
+        if (slot->fp != lastFp && std::find(dirty.begin(), dirty.end(), slot->fp) == dirty.end()) {
+            dirty.push_back(slot->fp);
+        }
+        lastFp = slot->fp;
+        slot->seq.store(pos + LOG_RING_SIZE, std::memory_order_release);
+        dequeuePos.store(pos + 1, std::memory_order_release);
+        n++;
+    }
+    uint64_t lost = dropped.load(std::memory_order_relaxed);
+    if (lost > reported && lastFp != nullptr) {
+        fprintf(lastFp, "%s - ERROR - logger - %lu lines dropped because the log queue was full\n",
+                prettyTime().c_str(), lost - reported);
+        reported = lost;
+    }
+    for (FILE* fp : dirty) {
+        fflush(fp);
+    }
+    dirty.clear();
+    flushedPos.store(dequeuePos.load(std::memory_order_relaxed), std::memory_order_release);
+    return n;
+}
+
+void Logger::run() {
+    while (true) {
+        if (drain() > 0) {
+            continue;
+        }
+        if (stopFlag.load()) {
+            drain();
+            break;
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        sleeping.store(1, std::memory_order_seq_cst);
+        uint64_t pos = dequeuePos.load(std::memory_order_relaxed);
+        if (slots[pos & (LOG_RING_SIZE - 1)].seq.load(std::memory_order_seq_cst) != pos + 1 && !stopFlag.load()) {
+            cond.wait_for(lock, std::chrono::milliseconds(LOG_IDLE_MS));
+        }
+        sleeping.store(0, std::memory_order_relaxed);
+    }
+}
+
+void Logger::flush(FILE* fp) {
+    uint64_t target = enqueuePos.load();
+    while (flushedPos.load(std::memory_order_acquire) < target) {
+        cond.notify_one();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    fflush(fp);
+}
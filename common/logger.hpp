@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <stdio.h>
+#include <thread>
+#include <vector>
+
+/* 日志级别，低于LOG_LEVEL的日志在编译期被去掉，例如 -DLOG_LEVEL=2 只保留ERROR */
+#define LOG_LEVEL_INFO 1
+#define LOG_LEVEL_ERROR 2
+#define LOG_LEVEL_NONE 3
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+#define LOG_RING_SIZE 4096 /* 日志环形队列的槽位数，必须是2的幂 */
+#define LOG_SLOT_SIZE 384  /* 每个槽位能容纳的一行日志（含时间前缀）的最大长度 */
+#define LOG_IDLE_MS 10     /* 后台线程无事可做时的最长睡眠时间（毫秒） */
+
+/* 异步日志：调用线程只负责格式化并把一行日志放进无锁的多生产者环形队列，
+ * 由后台线程批量写入文件，队列空时才fflush，因此事件循环不会因为磁盘而阻塞。
+ * 队列满时丢弃日志并计数，丢弃的行数由后台线程补记到日志中 */
+class Logger {
+private:
+    typedef struct Slot {
+        std::atomic<uint64_t> seq;                 /* 槽位序号，等于写入位置时可写，等于写入位置+1时可读 */
+        FILE*                 fp;                  /* 目标文件 */
+        uint16_t              len;                 /* 日志长度 */
+        char                  line[LOG_SLOT_SIZE]; /* 一行日志 */
+    } Slot;
+
+    Slot*                             slots;      /* 环形队列 */
+    alignas(64) std::atomic<uint64_t> enqueuePos; /* 下一个写入位置，由生产者竞争 */
+    alignas(64) std::atomic<uint64_t> dequeuePos; /* 下一个读出位置，只由后台线程修改 */
+    std::atomic<uint64_t>             flushedPos; /* 该位置之前的日志都已fflush */
+    std::atomic<uint64_t>             dropped;    /* 因队列满丢弃的行数 */
+    std::atomic<int>                  sleeping;   /* 后台线程是否在等待 */
+    std::atomic<int>                  stopFlag;   /* 是否通知后台线程退出 */
+    std::mutex                        mutex;      /* 只用于后台线程睡眠 */
+    std::condition_variable           cond;       /* 唤醒后台线程 */
+    std::thread                       writer;     /* 后台线程 */
+    std::once_flag                    started;    /* 第一次写日志时启动后台线程 */
+    uint64_t                          reported;   /* 已补记到日志中的丢弃行数（只由后台线程访问） */
+    std::vector<FILE*>                dirty;      /* 写入后尚未fflush的文件（只由后台线程访问） */
+
+    Logger();
+    void run();
+    int  drain();
+
+public:
+    ~Logger();
+
+    Logger(const Logger&)            = delete;
+    Logger& operator=(const Logger&) = delete;
+
+    static Logger& instance();
+
+    /* 把一行日志放进队列，队列满时丢弃并返回-1 */
+    int push(FILE* fp, const char* line, size_t len);
+
+    /* 等待此前放进队列的日志全部写入fp并fflush，关闭文件之前必须调用 */
+    void flush(FILE* fp);
+
+    uint64_t droppedCount() const {
+        return dropped.load(std::memory_order_relaxed);
+    }
+};
+
+/* 格式化一行带时间前缀的日志并交给Logger，level为LOG_LEVEL_ERROR时附加strerror(errno) */
+int logWrite(int level, int returnValue, FILE* fp, const char* fmt, ...);
+
+/* 等待fp上的日志全部写入磁盘缓存，fp为nullptr时直接返回 */
+void logFlush(FILE* fp);
+
+/* 打印非errno消息到log文件。被去掉的级别只在sizeof中引用参数，不产生任何代码 */
+#if LOG_LEVEL <= LOG_LEVEL_INFO
+#define logInfo(returnValue, fp, ...) logWrite(LOG_LEVEL_INFO, returnValue, fp, __VA_ARGS__)
+#else
+#define logInfo(returnValue, fp, ...) ((void)sizeof(logWrite(LOG_LEVEL_INFO, returnValue, fp, __VA_ARGS__)), (returnValue))
+#endif
+
+/* 打印errno消息到log文件 */
+#if LOG_LEVEL <= LOG_LEVEL_ERROR
+#define logError(returnValue, fp, ...) logWrite(LOG_LEVEL_ERROR, returnValue, fp, __VA_ARGS__)
+#else
+#define logError(returnValue, fp, ...) ((void)sizeof(logWrite(LOG_LEVEL_ERROR, returnValue, fp, __VA_ARGS__)), (returnValue))
+#endif